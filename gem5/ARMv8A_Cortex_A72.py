@@ -133,15 +133,23 @@ class ARM_A72_BP(BiModeBP):
     # be mostly-taken, the BiMode seems to be the closer one.
 
     # No static predictor on gem5. IndirectPredictor is already set and used by
-    # default. RAS is set and used by default.
+    # default. RAS is set and used by default, with gem5's default size
+    # (RASSize), which can be changed with ARM_A72_CoreCreate.
 
-def ARM_A72_CoreCreate(self, BaseCPU, idx):
+def ARM_A72_CoreCreate(self, BaseCPU, idx, ras_size=None, lsq_params=None):
     """Create an ARM_A72_Core.
 
     Specialize the ARM_A72_Core regarding the mode of the simulation.
 
     :param BaseCPU: Either "AtomicSimpleCPU" if system.mem_mode == "atomic",
                     DerivO3CPU otherwise.
+    :param ras_size: Number of entries of the return address stack of the
+                     branch predictor. gem5's default if None.
+    :param lsq_params: Parameters of the load/store queues and of the memory
+                       dependence predictor (store sets) of the DerivO3CPU, as
+                       a dictionary (e.g. {"LQEntries": 32, "SSITSize": 1024}).
+                       Ignored for the AtomicSimpleCPU. gem5's defaults if
+                       None.
     :returns: Return the configured core.
 
     """
@@ -160,6 +168,8 @@ def ARM_A72_CoreCreate(self, BaseCPU, idx):
         def branchPredAdd(self):
             """Instantiate the predifined branch predictor to this core."""
             self.branchPred = self.branchPred_type()
+            if ras_size is not None:
+                self.branchPred.RASSize = ras_size
 
     core = ARM_A72_Core(cpu_id=idx)
 
@@ -173,6 +183,10 @@ def ARM_A72_CoreCreate(self, BaseCPU, idx):
         core.commitWidth = 3
         core.dispatchWidth = 5
         core.issueWidth = 8
+        # Load/store queues (LQEntries, SQEntries) and store sets predictor
+        # (SSITSize, LFSTSize), which bound the window of Spectre-STL.
+        for name, value in (lsq_params or {}).items():
+            setattr(core, name, value)
         
     return core
 
@@ -233,12 +247,24 @@ class ARM_A72_Cluster(SubSystem):
     wcache_type = ARM_A72_CacheWalker
 
     # Constructor.
-    def __init__(self, system, num_cpus):
+    def __init__(self, system, num_cpus, ras_size=None, lsq_params=None, switchable=False):
         """Return a CPU cluster with the number of cores specified.
 
         The clock/voltage domain and the cores are configured. The memory
         hierarchy (caches) have to be connected to a memory bus later.
 
+        :param ras_size: Size of the return address stack of the cores (see
+                         ARM_A72_CoreCreate).
+        :param lsq_params: Load/store queues and memory dependence predictor
+                           parameters of the cores (see ARM_A72_CoreCreate).
+        :param switchable: If True, the system must be in atomic mode. The
+                           atomic cores get the caches anyway, to keep them
+                           warm while fast-forwarding, and a switched-out
+                           detailed core is added for each of them
+                           ("switch_cpus"), to run the detailed windows of a
+                           sampled simulation, or the workload of a cold boot
+                           sharing a host directory.
+
         """
         super().__init__()
         assert num_cpus > 0
@@ -251,7 +277,7 @@ class ARM_A72_Cluster(SubSystem):
 
         # Instantiate the core(s) of the CPU regarding the system memory mode.
         cpu_base = AtomicSimpleCPU if system.getMemoryMode() == "atomic" else DerivO3CPU
-        self.cpus = [self.cpu_type(cpu_base, idx) for idx in range(num_cpus)]
+        self.cpus = [self.cpu_type(cpu_base, idx, ras_size, lsq_params) for idx in range(num_cpus)]
 
         # Configure each core of the CPU:
         for cpu in self.cpus:
@@ -266,8 +292,20 @@ class ARM_A72_Cluster(SubSystem):
                 # Add the branch predictor.
                 cpu.branchPredAdd()
 
+        # Detailed cores of a switchable simulation, taking over the ports
+        # (and thus the caches) of the atomic ones when switched in.
+        if switchable:
+            assert system.getMemoryMode() == "atomic"
+            self.switch_cpus = [self.cpu_type(DerivO3CPU, idx, ras_size, lsq_params) for idx in range(num_cpus)]
+            for cpu in self.switch_cpus:
+                cpu.switched_out = True
+                cpu.createThreads()
+                cpu.createInterruptController()
+                cpu.branchPredAdd()
+
         # Configure the cluster:
-        if system.getMemoryMode() == "timing":
+        self._cached = system.getMemoryMode() == "timing" or switchable
+        if self._cached:
             # Configure the memory hierarchy of the cores and of the cluster.
             self.cacheAddL1()
             self.cacheAddL2()
@@ -5,9 +5,15 @@ ARM Cortex-A72 CPU. The intended use is security research. It can be used both
 in system-call emulation or full-system simulation. For the full-system
 simulation mode only, first boot your system and create a checkpoint where the
 used CPU will be the atomic one. Only then, restore you system from your
-checkpoint, where the CPU used will be the detailed one. When passing filenames
-in arguments of the script, please be sure that your M5_PATH environment
-variable is set accordingly.
+checkpoint, where the CPU used will be the detailed one. Long runs can be
+sampled (SMARTS-like): the atomic CPU fast-forwards with warm caches, and the
+detailed CPU only runs short periodic windows, from which the statistics are
+extrapolated with confidence intervals. A workload can also drop its own
+checkpoint once set up (e.g. "spectre --checkpoint", after the calibration of
+its thresholds), from which each point of a sweep of the microarchitecture is
+restored, in both modes, instead of simulating again the setup. When passing
+filenames in arguments of the script, please be sure that your M5_PATH
+environment variable is set accordingly.
 
 """
 
@@ -23,6 +29,14 @@ import time
 # Parsing.
 import argparse
 import shlex
+# Host resources.
+import resource
+# Sampling.
+import statistics
+# Accounting.
+import json
+# Statistics selection.
+import fnmatch
 
 # ** Gem5:
 
@@ -30,6 +44,8 @@ import shlex
 import m5
 # Python SimObjects list.
 from m5.objects import *
+# Conversion of the parameters (e.g. memory sizes).
+from m5.util import convert
 # Memory configuration helper.
 from common import MemConfig
 # System-path (M5_PATH) search helper.
@@ -46,6 +62,20 @@ from ARMv8A_Cortex_A72 import *
 args = None
 # Keep trace of elapsed time.
 t_start = None
+# True once a cold boot sharing a host directory switched to the detailed
+# cores (see simRun()).
+detailed = False
+# Statistics of the periodic time series (--stats-period) and of the windows of
+# a sampled simulation, by default: branch mispredictions, L1D and L2 misses,
+# and squashed instructions. Patterns of the full names, as written in the
+# statistics file (vectors end by "::total", see StatsReader).
+stats_series_default = ",".join([
+    "*branchPred.condIncorrect",
+    "*commit.branchMispredicts",
+    "*dcache.overall_misses::total",
+    "*l2.overall_misses::total",
+    "*commit.commitSquashedInsts",
+])
 
 # * Classes:
 
@@ -62,21 +92,57 @@ class RPIMem:
     mem_type = "DDR4_2400_16x4"
     # Determine the number of memory controllers for the MemConfig helper
     mem_channels = 1
-    # Size of the main memory.
+    # Default size of the main memory (see the --mem-size option).
     mem_size = '4096MB'
+    # Default size of the memory given to the Linux kernel, smaller than the
+    # default main memory as in the existing boot checkpoints.
+    kernel_mem_size = '2048MB'
+
+    def getMemSize(args):
+        """Get the size of the RPISystem DRAM, the default one if not given."""
+        return args.mem_size if args.mem_size is not None else RPIMem.mem_size
+
+    def getKernelMemSize(args):
+        """Get the size of the memory given to the Linux kernel in FS mode.
+
+        The whole DRAM if its size is given, the default kernel size
+        otherwise.
+
+        """
+        return args.mem_size if args.mem_size is not None else RPIMem.kernel_mem_size
 
     def getMemRanges(args):
         """Get the RPISystem DRAM memory ranges.
 
-        Return a list of ranges of DRAM memory. It should start from 0 for the
-        SE mode, but from 2GB for FS mode since the first 2GB are already
-        mapped by the RealView platform.
+        Return a list of ranges of DRAM memory, of the size given by the
+        arguments. It should start from 0 for the SE mode, but from 2GB for FS
+        mode since the first 2GB are already mapped by the RealView platform.
 
         """
         if args.se is True:
-            return [AddrRange(start=0, size=RPIMem.mem_size)]
+            return [AddrRange(start=0, size=RPIMem.getMemSize(args))]
         else:
-            return [AddrRange(start=0x80000000, size=RPIMem.mem_size)]
+            return [AddrRange(start=0x80000000, size=RPIMem.getMemSize(args))]
+
+class RPIHeadlessPlatform(VExpress_GEM5_V1_Base):
+    """Headless RealView platform.
+
+    The VExpress_GEM5_V1 platform without its HDLcd display controller. The
+    memory map, the interrupts, the UART, the PCI host of the VirtIO disks and
+    the timers are the same. The keyboard and mouse controllers are kept for
+    the memory map, but without input: no VNC server is needed.
+
+    Checkpoints are not compatible between both platforms: a checkpoint of
+    the default platform holds the state of the HDLcd, which the guest kernel
+    drives, and a headless checkpoint lacks it. A headless run must restore a
+    checkpoint booted headless (checked by argsCheck()).
+
+    """
+    def __init__(self, **kwargs):
+        super().__init__(**kwargs)
+        # Disconnect the PS/2 devices from the (non-existent) VNC server.
+        for kmi in (self.kmi0, self.kmi1):
+            kmi.ps2.vnc = NULL
 
 def RPISystemCreate(BaseSystem, args, mode):
     """Create an RPISystem which inherit dynamically from the class "BaseSystem".
@@ -114,8 +180,14 @@ def RPISystemCreate(BaseSystem, args, mode):
             # Tell gem5 about the memory mode used by the CPU we are simulating.
             self.mem_mode = mode
 
+            # Back the simulated memory by a host mapping without swap
+            # reservation: pages are only allocated when first touched, and
+            # many instances can share a host whatever their simulated size.
+            self.mmap_using_noreserve = True
+
             # Add the CPU cluster to the system, possibly with multiples cores.
-            self.cpu_cluster = ARM_A72_Cluster(self, args.num_cores)
+            self.cpu_cluster = ARM_A72_Cluster(self, args.num_cores, args.bp_ras_size,
+                                              lsqParams(args), args.sample_period is not None or args.fs_share is not None)
 
             # Configure the memory for the added cluster and the system.
             self.configMem(args)
@@ -145,8 +217,8 @@ def RPISystemCreate(BaseSystem, args, mode):
             self.system_port = self.membus.slave
 
             # Connect the cache hierarchy of the CPU cluster to the shared memory
-            # bus, if there is one.
-            if self.getMemoryMode() == "timing":
+            # bus, if there is one (detailed, sampled or switchable simulation).
+            if self.cpu_cluster._cached:
                 self.cpu_cluster.connectCacheL2(self.membus)
             else:
                 self.cpu_cluster.connectDirect(self.membus)
@@ -177,6 +249,36 @@ def RPISystemCreate(BaseSystem, args, mode):
                 
 # * Functions:
 
+def fsBootScriptCreate(args):
+    """Create the boot script given to the guest.
+
+    Write in the output directory the script read by "m5 readfile" in the
+    guest. It mounts the shared host directory, if any, under "/mnt/share",
+    enters it and switches to the detailed cores ("m5 switchcpu", see
+    simRun()), then runs the user-supplied script, if any. Nothing runs it
+    automatically: the guest has to fetch and run it, e.g. with "m5 readfile
+    > /tmp/rcS; sh /tmp/rcS" typed at its prompt or added to the init of its
+    disk image (see the README). A restored simulation gets the script of its
+    own run, but cannot have a shared directory (see argsCheck()).
+
+    :param args: Arguments of the script.
+    :returns: Path of the created script.
+
+    """
+    lines = ["#!/bin/sh"]
+    if args.fs_share is not None:
+        lines += ["mkdir -p /mnt/share",
+                  "mount -t 9p -o trans=virtio,version=9p2000.L,cache=none gem5 /mnt/share",
+                  "cd /mnt/share",
+                  "m5 switchcpu"]
+    if args.fs_script is not None:
+        with open(args.fs_script) as script:
+            lines.append(script.read())
+    path = os.path.join(m5.options.outdir, "boot.rcS")
+    with open(path, "w") as script:
+        script.write("\n".join(lines) + "\n")
+    return path
+
 def getTimeStr():
     """Return a string header with the time since the beginning of simulation."""
     return "[{:.3f}] ".format(time.time() - t_start)
@@ -189,6 +291,17 @@ def printVerbose(str):
         print(getTimeStr() + str)
     
 
+def lsqParams(args):
+    """Return the DerivO3CPU load/store parameters given on the command line.
+
+    Only the parameters set by the user are returned, as a dictionary suitable
+    for ARM_A72_Cluster.
+
+    """
+    names = {"LQEntries": args.o3_lq_entries, "SQEntries": args.o3_sq_entries,
+             "SSITSize": args.o3_ssit_size, "LFSTSize": args.o3_lfst_size}
+    return {name: value for name, value in names.items() if value is not None}
+
 def argsCheck(args):
     """Check arguments.
 
@@ -200,6 +313,53 @@ def argsCheck(args):
     if args.num_cores <= 0:
         print("Error: num_cores must be superior or equal to 1.")
         return 1
+    try:
+        mem_size = convert.toMemorySize(RPIMem.getMemSize(args))
+    except ValueError:
+        print("Error: mem_size must be a memory size (e.g. 512MB).")
+        return 1
+    if mem_size < 1 << 20 or (args.fs is True and mem_size > 8 << 30):
+        print("Error: mem_size must be between 1MB and 8GB (in fs-mode).")
+        return 1
+    if args.bp_ras_size is not None and args.bp_ras_size <= 0:
+        print("Error: bp_ras_size must be superior or equal to 1.")
+        return 1
+    if args.sample_period is not None:
+        if args.sample_warmup < 0 or args.sample_window <= 0:
+            print("Error: sample_warmup must be positive and sample_window superior or equal to 1.")
+            return 1
+        if args.sample_period <= args.sample_warmup + args.sample_window:
+            print("Error: sample_period must be superior to sample_warmup + sample_window.")
+            return 1
+        if not 0 < args.sample_confidence < 1:
+            print("Error: sample_confidence must be in ]0, 1[.")
+            return 1
+        if args.fs is True and args.fs_restore is None:
+            print("Error: sampling requires a restored system in fs-mode.")
+            return 1
+        if args.checkpoint_exit:
+            print("Error: sampling and checkpoint_exit are exclusive.")
+            return 1
+        if args.stats_period is not None:
+            print("Error: sampling and stats_period are exclusive (windows already read their statistics).")
+            return 1
+    if args.stats_period is not None:
+        try:
+            if convert.anyToLatency(args.stats_period) <= 0:
+                raise ValueError
+        except ValueError:
+            print("Error: stats_period must be a positive duration (e.g. 100us).")
+            return 1
+    for name in ("o3_lq_entries", "o3_sq_entries", "o3_ssit_size", "o3_lfst_size"):
+        if getattr(args, name) is not None and getattr(args, name) <= 0:
+            print("Error: {} must be superior or equal to 1.".format(name))
+            return 1
+    # The StoreSet predictor indexes its tables with a mask, and is fatal
+    # otherwise.
+    for name in ("o3_ssit_size", "o3_lfst_size"):
+        if getattr(args, name) is not None and getattr(args, name) & (getattr(args, name) - 1):
+            print("Error: {} must be a power of two.".format(name))
+            return 1
     if (args.fs is False and args.se is False) or (args.fs is True and args.se is True):
         print("Error: select either --fs or --se mode.")
         return 1
@@ -209,16 +369,35 @@ def argsCheck(args):
             print("Error: you must supply --fs-kernel and --fs-disk-image option.")
             return 1
         # False mode arguments.
-        if args.se_commands_to_run:
+        if args.se_commands_to_run or args.se_restore is not None:
             print("Error: fs-mode is selected but se-mode arguments are provided.")
             return 1
+        if args.fs_share is not None and not os.path.isdir(args.fs_share):
+            print("Error: fs_share must be an existing directory.")
+            return 1
+        if args.fs_script is not None and not os.path.isfile(args.fs_script):
+            print("Error: fs_script must be an existing file.")
+            return 1
+        # The platform of a restored checkpoint must be the one it was taken
+        # on, told by the state of the HDLcd of the default platform.
+        if args.fs_restore is not None and os.path.isfile(os.path.join(args.fs_restore, "m5.cpt")):
+            with open(os.path.join(args.fs_restore, "m5.cpt")) as cpt:
+                headless = not any(line.startswith("[system.realview.hdlcd") for line in cpt)
+            if headless != args.fs_headless:
+                print("Error: fs_restore was taken on the {} platform, fs_headless must {}be given.".format(
+                    "headless" if headless else "default", "" if headless else "not "))
+                return 1
+        # gem5 cannot checkpoint the VirtIO 9P device, nor restore it.
+        if args.fs_share is not None and (args.fs_restore is not None or args.checkpoint_exit):
+            print("Error: fs_share cannot be used with fs_restore nor checkpoint_exit (a VirtIO 9P device cannot be checkpointed).")
+            return 1
     if args.se is True:
         # Required arguments.
         if args.se_commands_to_run is None:
             print("Error: you must supply command positional argument.")
             return 1
         # False mode arguments.
-        if args.fs_kernel is not None or args.fs_disk_image is not None or args.fs_restore is not None or args.fs_workload_image is not None:
+        if args.fs_kernel is not None or args.fs_disk_image is not None or args.fs_restore is not None or args.fs_workload_image is not None or args.fs_headless or args.fs_share is not None or args.fs_script is not None:
             print("Error: se-mode is selected but fs-mode arguments are provided.")
             return 1
         
@@ -266,8 +445,9 @@ def systemCreate(args):
     """
     # Configure the SE-mode.
     if args.se:
-        # Use a Raspberry Pi system.
-        system = RPISystemCreate(System, args, "timing")
+        # Use a Raspberry Pi system, fast-forwarded by the atomic CPU if
+        # sampled.
+        system = RPISystemCreate(System, args, "atomic" if args.sample_period else "timing")
         # Configure the workload. Parse the end of the command line and get a
         # list of "Processes" instances that we can pass to gem5. The number of
         # processes must match the number of cores.
@@ -279,25 +459,32 @@ def systemCreate(args):
         # Assign one process to a workload for each CPU.
         for cpu, process in zip(system.cpu_cluster.cpus, processes):
             cpu.workload = process
+        for cpu, process in zip(getattr(system.cpu_cluster, "switch_cpus", []), processes):
+            cpu.workload = process
     # Configure the FS-mode.
     # TODO This section needs a refactoring. All gem5 related configuration
     # goes here (e.g. workload), where all system architecture configuration
     # goes into the System class.
     else:
         # Choose the mode (and indirectly, the CPU and the cache hierarchy)
-        # depending on if we restore an already-booted system or not.
-        mode = "timing" if args.fs_restore else "atomic"
+        # depending on if we restore an already-booted system or not. A
+        # sampled simulation always starts with the atomic CPU. So does a cold
+        # boot sharing a host directory, which switches to the detailed CPU
+        # when the guest asks (see simRun()).
+        mode = "timing" if args.fs_restore and not args.sample_period else "atomic"
         # Use a Raspberry Pi system.
         system = RPISystemCreate(ArmSystem, args, mode)
         # Add a DVFS handler to the system, in order to communicate with the
         # Energy controller and suppress a warning. If we really want to use
         # it, we can de-comment the line which assign to it a domain to handle.
-        system.dvfs_handler = DVFSHandler(enable=True)
-        # system.dvfs_handler.domains = [system.cpu_cluster.clk_domain]
+        # A headless system doesn't need it.
+        if not args.fs_headless:
+            system.dvfs_handler = DVFSHandler(enable=True)
+            # system.dvfs_handler.domains = [system.cpu_cluster.clk_domain]
         # Model a RealView ARM Platform, default platform for ARM simulation on
         # gem5. This platform define memory map, interrupts, GIC, and a lot of
-        # other low-level things.
-        system.realview = VExpress_GEM5_V1()
+        # other low-level things. The headless one has no display.
+        system.realview = RPIHeadlessPlatform() if args.fs_headless else VExpress_GEM5_V1()
         # Set the address of the 'Flags' register, used for SMP booting. The
         # primary CPU writes the secondary start address here before sends it a
         # soft interrupt. The secondary CPU reads this register and if it's
@@ -343,6 +530,16 @@ def systemCreate(args):
         if args.fs_workload_image is not None:
             system.pci_vio_workload = PciVirtIO(vio=VirtIOBlock(image=fsImageCOWCreate(args.fs_workload_image)))
             system._pci_devices.append(system.pci_vio_workload)
+        # If a host directory is shared, then export it through a VirtIO 9P
+        # device, served by a diod process on a socket of the output
+        # directory (one per instance). The guest mounts it by its tag with
+        # the boot script, and reads or writes the host files directly, with
+        # no image to rebuild.
+        if args.fs_share is not None:
+            system.pci_vio_share = PciVirtIO(vio=VirtIO9PDiod(
+                root=os.path.abspath(args.fs_share), tag="gem5",
+                socketPath=os.path.join(os.path.abspath(m5.options.outdir), "9p.sock")))
+            system._pci_devices.append(system.pci_vio_share)
         # Attach the PCI devices to the system. The helper method of the
         # RealView component in the system assigns a unique PCI bus ID to each
         # of the devices and connects them to the IO bus.
@@ -374,7 +571,7 @@ def systemCreate(args):
         # For each ISA of each CPU, add to it a PMU with a unique interrupt
         # number and the already implemented architectural event. An example of
         # this function could be found in "devices.py".
-        for cpu in system.cpu_cluster.cpus:
+        for cpu in system.cpu_cluster.cpus + getattr(system.cpu_cluster, "switch_cpus", []):
             for isa in cpu.isa:
                 # To choose an interrupt number, pick a free PPI interrupt in
                 # the platform interrupt mapping. Here, we choose PPI n°20,
@@ -395,12 +592,14 @@ def systemCreate(args):
                 isa.pmu.addEvent(ProbeEvent(isa.pmu, 0x33, getattr(system.cpu_cluster, "l2", None), "Miss"))
         
         # Attach a gem5 terminal (SerialDevice) listening on port 3456 to
-        # connect the system later.
+        # connect the system later. A headless system doesn't listen, see
+        # main(), but still dumps the terminal output in a file.
         system.terminal = Terminal()
         # Attach a VNC server to the system. It's required by the
         # VExpress_GEM5_V1 platform, even if you don't use it, for the HDLcd
         # controller (simulation of an LCD display with a frame buffer).
-        system.vncserver = VncServer()
+        if not args.fs_headless:
+            system.vncserver = VncServer()
         # Configure the workload for our system with the predefined class for
         # Linux kernel on ARM. Note that, in the SE mode, the workload is
         # directly passed to the CPU, unlike here.
@@ -428,43 +627,345 @@ def systemCreate(args):
             # Mount the root disk read-write by default.
             "rw",
             # Tell Linux about the amount of memory it should use and its base
-            # offset. Beware that it can't be superior to 8GB, otherwise the
-            # kernel will not boot with no message at all: gem5 will run and
-            # nothing happen. We make the kernel memory start at 2GB, as
+            # offset: the whole simulated DRAM if its size is given, 2GB of the
+            # default 4GB otherwise, as before. Beware that it can't be
+            # superior to 8GB, otherwise the kernel will not boot with no
+            # message at all: gem5 will run and nothing happen (checked by
+            # argsCheck()). We make the kernel memory start at 2GB, as
             # specified by the RealView platform.
-            "mem=2G@0x80000000",
+            "mem=%dM@0x80000000" % (convert.toMemorySize(RPIMem.getKernelMemSize(args)) >> 20),
         ]
         system.workload.command_line = " ".join(kernel_cmd)
+        # Give the boot script to the guest, which reads it with "m5
+        # readfile". It is read when asked, so that a restored system gets the
+        # script of its own run.
+        if args.fs_share is not None or args.fs_script is not None:
+            system.readfile = fsBootScriptCreate(args)
 
     return system
 
+class StatsReader:
+    """Reader of selected statistics, straight from the statistic objects.
+
+    The statistics are read without being dumped: nothing is written to the
+    statistics file ("stats.txt" by default), which only gets gem5's dump at
+    exit. Both kinds of gem5's statistics are walked: the legacy ones,
+    registered with their full name, and the ones of the statistic groups of
+    the SimObjects, named after the path of their group. They are named as in
+    the statistics file, the entries of a vector or formula being suffixed by
+    "::" and their subname, or "::total" for their sum (unless the vector has
+    a single entry), and only the ones whose name matches one of the selected
+    patterns are read. Scalars, vectors and formulas are supported, but not
+    distributions.
+
+    """
+    def __init__(self, patterns):
+        self.patterns = patterns
+        # Selected entries, as (name, function returning the value), resolved
+        # at the first read, once the statistics are registered.
+        self.entries = None
+
+    def entriesOf(self, name, info):
+        """Return the entries of a statistic, as a list of their name and a
+        function returning their value."""
+        # Vectors and formulas.
+        if hasattr(info, "subnames"):
+            size, subnames = info.size(), list(info.subnames)
+            # A single entry is written with the name of the statistic only.
+            if size == 1:
+                return [(name, lambda: info.result()[0])]
+            return [(name + "::" + (subnames[i] if i < len(subnames) and subnames[i] else str(i)),
+                     lambda i=i: info.result()[i]) for i in range(size)] + [(name + "::total", info.total)]
+        # Scalars.
+        if hasattr(info, "result"):
+            return [(name, info.result)]
+        return []
+
+    def resolve(self):
+        """Return the selected entries of all the statistics."""
+        infos = [(info.name, info) for info in m5.stats.stats_list]
+
+        def walk(group, path):
+            for info in group.getStats():
+                infos.append((path + info.name, info))
+            for name, child in group.getStatGroups().items():
+                walk(child, path + name + ".")
+        walk(Root.getInstance(), "")
+        return [entry for name, info in infos for entry in self.entriesOf(name, info)
+                if any(fnmatch.fnmatch(entry[0], pattern) for pattern in self.patterns)]
+
+    def read(self):
+        """Return the current values of the selected statistics, as an
+        ordered dictionary of their name to their value (a string, as
+        written in the statistics file)."""
+        if self.entries is None:
+            self.entries = self.resolve()
+        # Same preparation as before a dump, for the statistics computed then.
+        Root.getInstance().preDumpStats()
+        m5.stats.prepare()
+        stats = {}
+        for name, value in self.entries:
+            value = float(value())
+            stats[name] = "%d" % value if value.is_integer() else repr(value)
+        return stats
+
+class StatsSeries:
+    """Compact time series of selected statistics.
+
+    At the end of each period, the selected statistics (see StatsReader) are
+    read then all the statistics are reset, and the selected ones are written
+    as one CSV line to "stats_series.csv" in the output directory. Nothing is
+    dumped: the statistics file only holds gem5's dump at exit, the one of
+    the last, partial, period, also written to the series at exit. The sum of
+    the series is the whole run.
+
+    """
+    def __init__(self, args):
+        self.reader = StatsReader(args.stats_select.split(","))
+        self.names = None
+        self.file = open(os.path.join(m5.options.outdir, "stats_series.csv"), "w")
+
+    def write(self, reset=True):
+        """Write the selected statistics of the period ending at the current
+        tick, then reset the statistics for the next one, unless this is the
+        last one."""
+        stats = self.reader.read()
+        if reset:
+            m5.stats.reset()
+        # The names are only known from the first read, the header is written
+        # with the first line.
+        if self.names is None:
+            self.names = list(stats)
+            if not self.names:
+                print("Warning: no statistic matches --stats-select.")
+            self.file.write(",".join(["tick"] + self.names) + "\n")
+        self.file.write(",".join([str(m5.curTick())] + [stats.get(name, "") for name in self.names]) + "\n")
+        self.file.flush()
+
 def simRun(args):
     """Run the actual simulation.
 
     This function run the simulation and handle some runtime gem5's service
-    passed by special events, like taking a checkpoint.
+    passed by special events, like taking a checkpoint. With a statistics
+    period, the simulation also stops every period to write the selected
+    statistics and reset them (see StatsSeries), the last partial period
+    included.
 
     :param args: Arguments of the script.
     :returns: gem5's exit event.
 
     """
+    global detailed
+    series = StatsSeries(args) if args.stats_period else None
+    period = m5.ticks.fromSeconds(convert.anyToLatency(args.stats_period)) if series else None
+    next_dump = m5.curTick() + period if series else None
     # Infinite loop to handle events passed by exit_msg, until a real exit
     # happened.
     while True:
-        # Launch the simulation and get the exit reason.
-        event = m5.simulate()
+        # Launch the simulation, until the next dump if any, and get the exit
+        # reason.
+        event = m5.simulate(next_dump - m5.curTick()) if series else m5.simulate()
         exit_msg = event.getCause()
+        # If the period is over, write the statistics and start the next one.
+        if series and exit_msg == "simulate() limit reached" and m5.curTick() >= next_dump:
+            series.write()
+            next_dump += period
+            continue
         # If the exist reason is to take a checkpoint, then take it and restart
-        # the simulation.
-        if exit_msg == "checkpoint":
+        # the simulation, or stop there if the run only prepares it.
+        # With a shared directory, no checkpoint can be taken: a request of the
+        # guest to switch the cores or to take a checkpoint switches once to
+        # the detailed cores instead, which run the workload from there.
+        # A sampled simulation switches the cores by itself.
+        if exit_msg in ("switchcpu", "checkpoint") and args.fs_share is not None:
+            system = Root.getInstance().system
+            if args.sample_period or detailed:
+                print("Warning: %s skipped at tick %d, %s." % (exit_msg, m5.curTick(),
+                      "already on the detailed cores" if detailed else "the sampling switches the cores"))
+            else:
+                printVerbose("Switching to the detailed cores at tick %d" % m5.curTick())
+                m5.switchCpus(system, list(zip(system.cpu_cluster.cpus, system.cpu_cluster.switch_cpus)))
+                detailed = True
+        elif exit_msg == "checkpoint":
             printVerbose("Dropping checkpoint at tick %d" % m5.curTick())
             cpt_dir = os.path.join(m5.options.outdir, "cpt.%d" % m5.curTick())
             m5.checkpoint(os.path.join(cpt_dir))
             printVerbose("Checkpoint done.")
+            if args.checkpoint_exit:
+                break
         # If this is not a special exit reason, exit the simulation.
         else:
-            return event
-        
+            break
+    # The last (partial) period, not reset: gem5 also dumps it at exit.
+    if series:
+        series.write(reset=False)
+        series.file.close()
+    return event
+
+def simSample(args, system):
+    """Run a sampled simulation.
+
+    Periodically, every "sample_period" instructions of the first core: the
+    atomic cores fast-forward, keeping the caches warm, then the detailed cores
+    take over for "sample_warmup" instructions, to warm the pipeline and the
+    branch predictor, and for "sample_window" measured instructions, whose
+    statistics are read. The CPI of each window and its statistics selected
+    by --stats-select (see StatsReader) are written to "sampling.csv" in the
+    output directory. The CPI, the runtime and the selected statistics of the
+    whole run are extrapolated from them with a confidence interval, over the
+    instructions of the first core.
+
+    :param args: Arguments of the script.
+    :param system: The system, with a sampled cluster.
+    :returns: gem5's exit event.
+
+    """
+    cpus = system.cpu_cluster.cpus
+    switch_cpus = system.cpu_cluster.switch_cpus
+    ticks_per_cycle = m5.ticks.fromSeconds(1 / m5.util.convert.toFrequency(ARM_A72_Cluster._cpu_clock))
+    fast_forward = args.sample_period - args.sample_warmup - args.sample_window
+    reader = StatsReader(args.stats_select.split(","))
+    cpis = []
+    # Values of the selected statistics, by name, one per window.
+    stats = None
+
+    def runInsts(cpu, insts):
+        """Run "insts" instructions of the first core. Return None once done,
+        or the exit event if the simulation stopped for another reason."""
+        cpu.scheduleInstStop(0, insts, "sample")
+        event = simRun(args)
+        return None if event.getCause() == "sample" else event
+
+    def interval(values):
+        """Return the mean of values and the half-width of its normal
+        confidence interval."""
+        z = statistics.NormalDist().inv_cdf((1 + args.sample_confidence) / 2)
+        return statistics.mean(values), z * statistics.stdev(values) / len(values) ** 0.5
+
+    with open(os.path.join(m5.options.outdir, "sampling.csv"), "w") as f:
+        while True:
+            # Fast-forward, then switch to the detailed cores.
+            event = runInsts(cpus[0], fast_forward)
+            if event:
+                break
+            m5.switchCpus(system, list(zip(cpus, switch_cpus)))
+            # Detailed warm-up, then the measured window.
+            event = runInsts(switch_cpus[0], args.sample_warmup) if args.sample_warmup else None
+            if event is None:
+                m5.stats.reset()
+                start = m5.curTick()
+                event = runInsts(switch_cpus[0], args.sample_window)
+            if event is None:
+                window = reader.read()
+                # The selected statistics are known from the first window.
+                if stats is None:
+                    stats = {name: [] for name in window}
+                    f.write(",".join(["window", "tick", "ticks", "cpi"] + list(stats)) + "\n")
+                for name, values in stats.items():
+                    values.append(float(window.get(name, "nan")))
+                cpis.append((m5.curTick() - start) / ticks_per_cycle / args.sample_window)
+                f.write(",".join(["%d" % len(cpis), "%d" % start, "%d" % (m5.curTick() - start), "%.4f" % cpis[-1]]
+                                 + [window.get(name, "") for name in stats]) + "\n")
+                printVerbose("Window %d: CPI %.4f" % (len(cpis), cpis[-1]))
+            if event:
+                break
+            # Switch back to the atomic cores.
+            m5.switchCpus(system, list(zip(switch_cpus, cpus)))
+
+    # Extrapolate from the windows, with a normal confidence interval, over the
+    # instructions of the first core (atomic and detailed), the one driving
+    # the windows.
+    insts = cpus[0].totalInsts() + switch_cpus[0].totalInsts()
+    if len(cpis) >= 2:
+        mean, error = interval(cpis)
+        print("Sampling: %d windows, %d instructions of core 0, CPI %.4f +- %.4f, %.0f +- %.0f cycles (%.1f%% confidence)"
+              % (len(cpis), insts, mean, error, mean * insts, error * insts, args.sample_confidence * 100))
+        # A statistic of a window counts events of "sample_window"
+        # instructions: scale it to the whole run.
+        for name, values in stats.items():
+            mean, error = interval(values)
+            scale = insts / args.sample_window
+            print("Sampling: %s %.2f +- %.2f per window, %.0f +- %.0f in total"
+                  % (name, mean, error, mean * scale, error * scale))
+    else:
+        print("Sampling: %d window(s), not enough to extrapolate." % len(cpis))
+    return event
+
+def simInsts(system):
+    """Return the number of instructions committed by all the cores (atomic
+    and detailed) of the system."""
+    cluster = system.cpu_cluster
+    return sum(cpu.totalInsts() for cpu in cluster.cpus + getattr(cluster, "switch_cpus", []))
+
+def leakedBytes(path):
+    """Return the sum of the "correct bytes" column of a Spectre output.
+
+    The output can be mixed with other lines (e.g. a gem5 "simout" file): only
+    the lines following a Spectre CSV header and having as many fields are
+    counted.
+
+    :param path: Path of the file holding the Spectre output.
+    :returns: Number of correctly leaked bytes, or None if there is no
+              Spectre output in the file.
+
+    """
+    column = fields = total = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            cells = line.strip().split(",")
+            if "correct bytes" in cells:
+                column, fields = cells.index("correct bytes"), len(cells)
+                total = total or 0
+            elif column is not None and len(cells) == fields and cells[column].isdigit():
+                total += int(cells[column])
+    return total
+
+def simAccount(args, system, run):
+    """Run the simulation and account for its cost on the host.
+
+    Measure over "run" the host wall time, the simulated ticks, the committed
+    instructions and the peak host memory, and write them with the derived
+    throughputs to "host.json" in the output directory. If the Spectre output
+    is given (--leak-output), also divide the host time by the number of
+    correctly leaked bytes: the cost of a campaign is budgeted from it.
+
+    :param args: Arguments of the script.
+    :param system: The simulated system.
+    :param run: Function running the simulation, returning gem5's exit event.
+    :returns: gem5's exit event.
+
+    """
+    host_start, tick_start, insts_start = time.time(), m5.curTick(), simInsts(system)
+    event = run()
+    host = time.time() - host_start
+    ticks = m5.curTick() - tick_start
+    insts = simInsts(system) - insts_start
+    summary = {
+        "exit cause": event.getCause(),
+        "host seconds": host,
+        "simulated ticks": ticks,
+        "simulated seconds": ticks / m5.ticks.fromSeconds(1),
+        "instructions": insts,
+        "host instructions per second": insts / host if host else None,
+        "host seconds per simulated second": host / (ticks / m5.ticks.fromSeconds(1)) if ticks else None,
+        # Peak resident set of this instance, in KiB on Linux.
+        "host max rss kib": resource.getrusage(resource.RUSAGE_SELF).ru_maxrss,
+        "simulated dram": RPIMem.getMemSize(args),
+    }
+    if args.leak_output is not None:
+        leaked = leakedBytes(args.leak_output) if os.path.isfile(args.leak_output) else None
+        summary["leaked bytes"] = leaked
+        summary["host seconds per leaked byte"] = host / leaked if leaked else None
+    with open(os.path.join(m5.options.outdir, "host.json"), "w") as f:
+        json.dump(summary, f, indent=4)
+        f.write("\n")
+    print(getTimeStr() + "Host: %.1f s for %d instructions (%.0f inst/s), %d MiB max RSS for %s of simulated DRAM" %
+          (host, insts, insts / host if host else 0, summary["host max rss kib"] >> 10, summary["simulated dram"]))
+    if summary.get("host seconds per leaked byte") is not None:
+        print(getTimeStr() + "Host: %.1f s per leaked byte (%d bytes)" %
+              (summary["host seconds per leaked byte"], summary["leaked bytes"]))
+    return event
+
 # * Entry:
 
 def main():
@@ -479,6 +980,30 @@ def main():
                         help="Print detailed information of what is done")
     parser.add_argument("--num-cores", type=int, default=1,
                         help="Number of CPU cores (default = 1)")
+    parser.add_argument("--mem-size", type=str,
+                        help="Size of the simulated DRAM, also given whole to the Linux kernel in fs-mode (default = %s, of which the kernel uses %s as before, compatible with the existing boot checkpoints; another size requires a new boot checkpoint)" % (RPIMem.mem_size, RPIMem.kernel_mem_size))
+    parser.add_argument("--bp-ras-size", type=int,
+                        help="Number of entries of the return address stack of the branch predictor (default = gem5's default)")
+    parser.add_argument("--o3-lq-entries", type=int,
+                        help="Number of entries of the load queue of the detailed CPU (default = gem5's default)")
+    parser.add_argument("--o3-sq-entries", type=int,
+                        help="Number of entries of the store queue of the detailed CPU (default = gem5's default)")
+    parser.add_argument("--o3-ssit-size", type=int,
+                        help="Number of entries of the store set ID table of the memory dependence predictor, a power of two (default = gem5's default)")
+    parser.add_argument("--o3-lfst-size", type=int,
+                        help="Number of entries of the last fetched store table of the memory dependence predictor, a power of two (default = gem5's default)")
+    parser.add_argument("--sample-period", type=int,
+                        help="Enable the sampled simulation: one detailed window every SAMPLE_PERIOD instructions of the first core (default = full detailed simulation)")
+    parser.add_argument("--sample-warmup", type=int, default=2000,
+                        help="Detailed instructions run before each measured window (default = 2000)")
+    parser.add_argument("--sample-window", type=int, default=1000,
+                        help="Measured detailed instructions of each window (default = 1000)")
+    parser.add_argument("--sample-confidence", type=float, default=0.997,
+                        help="Confidence level of the extrapolated statistics (default = 0.997)")
+    parser.add_argument("--stats-period", type=str,
+                        help="Period of simulated time (e.g. 100us) at which the selected statistics are read and written to 'stats_series.csv' in the output directory, then all the statistics reset; nothing is dumped per period, the statistics file only holds the last, partial, period, dumped at exit and also written to the series (default = disabled)")
+    parser.add_argument("--stats-select", type=str, default=stats_series_default,
+                        help="Comma-separated patterns of the full names of the statistics of the time series, and of the windows of a sampled simulation (default = %s)" % stats_series_default)
     parser.add_argument("--se", action="store_true",
                         help="Enable system-call emulation (must provide 'command' positional arguments)")
     parser.add_argument("se_commands_to_run", metavar="se-command", nargs='*',
@@ -493,6 +1018,18 @@ def main():
                         help="Filename of the disk image containing the workload to mount in full-system emulation")
     parser.add_argument("--fs-restore", type=str,
                         help="Path to a folder created by \"m5 checkpoint\" command to use for restoration")
+    parser.add_argument("--fs-share", type=str,
+                        help="Host directory shared with the guest through VirtIO 9P, mounted under '/mnt/share' by the boot script (requires diod on the host; only for a cold boot: a VirtIO 9P device cannot be checkpointed, so it excludes --fs-restore and --checkpoint-exit; the boot runs on the atomic cores with caches, and the boot script, or the first checkpoint request of the guest, switches to the detailed cores instead of a checkpoint)")
+    parser.add_argument("--fs-script", type=str,
+                        help="Script run by the guest after the mount of the shared directory, given through \"m5 readfile\": the init of the disk image must fetch and run it (see the README and the boot script in the output directory)")
+    parser.add_argument("--fs-headless", action="store_true",
+                        help="Use a headless platform in full-system emulation: no display, VNC server nor DVFS handler, and no listening port, to run many instances in parallel (checkpoints are not compatible with the default platform: restore a boot checkpoint taken with this option)")
+    parser.add_argument("--se-restore", type=str,
+                        help="Path to a folder created by a checkpoint of the workload (e.g. \"spectre --checkpoint\") to use for restoration in se-mode (commands must be the same as the checkpointed ones)")
+    parser.add_argument("--leak-output", type=str,
+                        help="File holding the CSV output of Spectre (e.g. in the shared directory, or gem5's simout), read after the run to account the host seconds per leaked byte in host.json")
+    parser.add_argument("--checkpoint-exit", action="store_true",
+                        help="Exit the simulation right after dropping the first checkpoint")
 
     args = parser.parse_args()
     if argsCheck(args):
@@ -505,20 +1042,31 @@ def main():
     # single node with shared memory.
     root.system = systemCreate(args)
 
+    # A headless system is only observed through its output files: close the
+    # terminal and remote debugging ports, for parallel instances not to
+    # compete for them.
+    if args.fs is True and args.fs_headless:
+        m5.disableAllListeners()
+
     # Instantiate the C++ object hierarchy. After this point, SimObjects can't
     # be instantiated anymore. The system can optionally by restored from a
-    # previous checkpoint.
+    # previous checkpoint, taken by "m5 checkpoint" in fs-mode or by the
+    # workload itself in both modes.
     printVerbose("Instantiate the system.")
-    if args.fs is True and args.fs_restore is not None:
-        m5.instantiate(args.fs_restore)
+    restore = args.fs_restore if args.fs is True else args.se_restore
+    if restore is not None:
+        m5.instantiate(restore)
     else:
         m5.instantiate()
 
     # Start the simulator. This gives control to the C++ world and starts
     # executing instructions. The returned event tells the simulation script
-    # why the simulator exited.
+    # why the simulator exited. Its cost on the host, including the memory
+    # used by this instance to know how many instances a host can run in
+    # parallel, is accounted for.
     printVerbose("Start the simulation.")
-    event = simRun(args)
+    event = simAccount(args, root.system,
+                       lambda: simSample(args, root.system) if args.sample_period else simRun(args))
 
     # Print the reason for the simulation exit and quit.
     printVerbose("%s @ %d" % (event.getCause(), m5.curTick()))
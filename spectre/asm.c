@@ -1,16 +1,22 @@
 /**
- * \brief  ARM Assembly.
+ * \brief  Architecture abstraction layer.
  * \author Pierre AYOUB -- IRISA, CNRS
  * \date   2020
  *
- * \details Contain all ARM assembly related stuff. It can be constants or
- *          (macro-)function. The ARM ISA targeted here is only the ARMv8-A
- *          one.
+ * \details Functions built on top of the architecture-specific primitives.
  */
 
+#include <stdio.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
 #include "asm.h"
 
-int reload_t(void *ptr) {
+HOT_PATH HOT_SECTION("timer") int reload_t(void *ptr) {
     /* Measured times. */
     uint64_t start = 0, end = 0;
     /* Measure the time, load the byte, re-measure the time. */
@@ -22,7 +28,7 @@ int reload_t(void *ptr) {
     return (int)(end - start);
 }
 
-int flush_reload_t(void *ptr) {
+HOT_PATH HOT_SECTION("timer") int flush_reload_t(void *ptr) {
     /* Measured times. */
     uint64_t start = 0, end = 0;
     /* Measure the time, load the byte, re-measure the time. */
@@ -35,3 +41,32 @@ int flush_reload_t(void *ptr) {
     /* Compute the elapsed time. */
     return (int)(end - start);
 }
+
+long cpu_id(int core) {
+#if defined(__aarch64__)
+    char path[128];
+    long val = -1;
+    FILE * f;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/regs/identification/midr_el1", core);
+    if ((f = fopen(path, "r"))) {
+        if (fscanf(f, "%li", &val) != 1)
+            val = -1;
+        fclose(f);
+    }
+    return val;
+#elif defined(__x86_64__)
+    /* Identical on all cores of a package. */
+    unsigned int eax, ebx, ecx, edx;
+    (void) core;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) ? (long) eax : -1;
+#endif
+}
+
+int sb_supported(void) {
+#if defined(__aarch64__)
+    /* HWCAP_SB, from the kernel's "asm/hwcap.h". */
+    return !!(getauxval(AT_HWCAP) & (1UL << 29));
+#elif defined(__x86_64__)
+    return 1;
+#endif
+}
@@ -0,0 +1,340 @@
+/**
+ * \brief  ARM Assembly.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Contain all ARM assembly related stuff. It can be constants or
+ *          (macro-)function. The ARM ISA targeted here is only the ARMv8-A
+ *          one.
+ *
+ * \warning Do not include this file directly, include "asm.h" instead.
+ */
+
+#ifndef _ASM_ARM64_H_
+#define _ASM_ARM64_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+/* * Documentation: */
+
+/** DSB -- Data Synchronization Barrier for Reads/Writes
+ * 
+ * A DSB instruction is a memory barrier that ensures that memory accesses that
+ * occur before the DSB instruction have completed before the completion of the
+ * DSB instruction. In doing this, it acts as a stronger barrier than a DMB and
+ * all ordering that is created by a DMB with specific options is also
+ * generated by a DSB with the same options.
+ *
+ * A DSB instruction executed completes when all the following apply: 1) All
+ * explicit memory accesses of the required access types appearing in program
+ * order before the DSB are complete for the set of observers in the required
+ * shareability domain. 2) If the required access types of the DSB is reads and
+ * writes, then all cache maintenance instructions, all TLB maintenance
+ * instructions, and all PSB CYNC instructions issued before the DSB are
+ * complete for the required shareability domain.
+ * 
+ * In addition, no instruction that appears in program order after the DSB
+ * instruction can alter any state of the system or perform any part of its
+ * functionality until the DSB completes other than: 1) Being fetched from
+ * memory and decoded. 2) Reading the general-purpose, SIMD and floating-point,
+ * Special-purpose, or System registers that are directly or indirectly read
+ * without causing side-effects.
+ * 
+ * Options:
+ * - ISH: Inner Shareable
+ * - SY:  Full System
+ */
+
+/** ISB -- Instruction Synchronization Barrier
+ * 
+ * An ISB instruction ensures that all instructions that come after the ISB
+ * instruction in program order are fetched from the cache or memory after the
+ * ISB instruction has completed. Using an ISB ensures that the effects of
+ * context-changing operations executed before the ISB are visible to the
+ * instructions fetched after the ISB instruction. Examples of context-changing
+ * operations that require the insertion of an ISB instruction to ensure the
+ * effects of the operation are visible to instructions fetched after the ISB
+ * instruction are: 1) Completed cache and TLB maintenance instructions. 2)
+ * Changes to System registers. Any context-changing operations appearing in
+ * program order after the ISB instruction only take effect after the ISB has
+ * been executed.
+ */
+
+/** DC CIVAC -- Data Cache Maintenance 
+ *
+ * Clean and Invalidate data cache by address to Point of Coherency (The point
+ * at which all agents that can access memory are guaranteed to see the same
+ * copy of a memory location for accesses of any memory type or cacheability
+ * attribute. In many cases this is effectively the main system memory,
+ * although the architecture does not prohibit the implementation of caches
+ * beyond the PoC that have no effect on the coherency between memory system
+ * agents.).
+ *
+ * Arguments:
+ * - Virtual address to use. No alignment restrictions apply to this VA.
+ */
+
+/** CSDB -- Consumption of Speculative Data Barrier
+ *
+ * Controls speculative execution and data value prediction. No instruction
+ * other than branch instructions appearing in program order after the CSDB
+ * can be speculatively executed using the results of any data value
+ * predictions of any instructions, or PSTATE.{N,Z,C,V} predictions of any
+ * instructions other than conditional branch instructions, appearing in
+ * program order before the CSDB that have not been architecturally resolved.
+ * In other words, the result of a CSEL or SBC before a CSDB is never a
+ * predicted one. Encoded in the hint space, it is a NOP on cores without
+ * support.
+ */
+
+/** SB -- Speculation Barrier
+ *
+ * Prevents speculative execution of the instructions after the SB until the
+ * SB has completed, without the cost of the DSB SY; ISB sequence. Part of
+ * ARMv8.5-A (FEAT_SB, optional from ARMv8.0-A): UNDEFINED on older cores
+ * such as the Cortex-A72, \sa {sb_supported()}.
+ */
+
+/* * Implementation: */
+
+/* ** Macro-functions: */
+
+/**
+ * \brief   Memory barrier for the inner shareable domain.
+ * \details Memory barrier that ensures that memory accesses that occur before
+ *          the function have completed before the completion of the function.
+ */
+#define mfence()                                \
+    do {                                        \
+        asm volatile("DSB ISH" ::: "memory");   \
+    } while (0)
+
+/**
+ * \brief   Memory barrier for the system domain.
+ * \details Memory barrier that ensures that memory accesses that occur before
+ *          the function have completed before the completion of the function.
+ */
+
+#define mfence_sys()                            \
+    do {                                        \
+        asm volatile("DSB SY" ::: "memory");    \
+    } while (0)
+
+/**
+ * \brief   Instruction barrier.
+ * \details Ensures that all instructions that come after the function in
+ *          program order are fetched from the cache or memory after the
+ *          function has completed.
+ */
+#define ifence()                                \
+    do {                                        \
+        asm volatile("ISB" ::: "memory");       \
+    } while (0)
+
+/**
+ * \brief   Flush an address from the cache.
+ * \details Clean and Invalidate data cache by address to Point of Coherency.
+ * \warning After flushing, IMPERATIVELY use in this order:
+ *          - \sa {mfence}
+ *          - \sa {ifence}
+ *
+ * \param  pointer Virtual address (VA)) to flush from the cache.
+ */
+#define flush(pointer)                                              \
+    do {                                                            \
+        asm volatile("DC CIVAC, %0" : : "r" (pointer) : "memory");  \
+    } while (0)
+
+/**
+ * \brief   Prohibit speculation.
+ * \details By using a \sa {mfence_sys} and a \sa {ifence}, prohibit the CPU to
+ *          speculate for the instructions that come after the function.
+ */
+#define nospec()                                \
+    do {                                        \
+        mfence_sys();                           \
+        ifence();                               \
+    } while (0)
+
+/**
+ * \brief   Consumption of speculative data barrier.
+ * \details The conditional selections done before the function are never
+ *          speculated on by the instructions after it.
+ */
+#define csdb()                                  \
+    do {                                        \
+        asm volatile("HINT #20" ::: "memory");  \
+    } while (0)
+
+/**
+ * \brief   Speculation barrier.
+ * \warning Only if \sa {sb_supported()}, SIGILL otherwise. Written as its
+ *          encoding, for assemblers without ARMv8.5-A.
+ */
+#define sb()                                            \
+    do {                                                \
+        asm volatile(".inst 0xd50330ff" ::: "memory");  \
+    } while (0)
+
+/**
+ * \brief   Speculative store bypass barrier.
+ * \details A load after the function never speculatively reads a value older
+ *          than a store to the same address before it. Available on all the
+ *          ARMv8-A cores, written as its encoding (DSB #0) for older
+ *          assemblers.
+ */
+#define ssbb()                                          \
+    do {                                                \
+        asm volatile(".inst 0xd503309f" ::: "memory");  \
+    } while (0)
+
+/**
+ * \brief   Take a gem5 checkpoint.
+ * \details Issue the m5 pseudo-instruction "checkpoint" (function 0x43, no
+ *          delay nor period), encoded for the gem5 ARM decoder. Only valid
+ *          under gem5, the instruction is undefined on real hardware.
+ */
+#define m5_checkpoint()                                         \
+    do {                                                        \
+        asm volatile("MOV X0, #0\n"                             \
+                     "MOV X1, #0\n"                             \
+                     ".long 0xff430110\n"                       \
+                     ::: "x0", "x1", "memory");                 \
+    } while (0)
+
+/**
+ * \brief   Mispredict a return.
+ * \details Branch-and-link to a stub which reloads the link register with
+ *          the address of the end of the macro, stored and flushed in
+ *          "slot". The return stack predicts a return right after the
+ *          branch, where a branch to "label" is speculatively executed until
+ *          the real return address is loaded.
+ *
+ * \param slot Pointer to a flushable cache line holding a "void *".
+ * \param label C label of the speculative target.
+ */
+#define ret_mispredict(slot, label)                                     \
+    asm goto("ADR X9, 2f\n"                                             \
+             "STR X9, [%0]\n"                                           \
+             "DC CIVAC, %0\n"                                           \
+             "DSB ISH\n"                                                \
+             "ISB\n"                                                    \
+             "BL 1f\n"                                                  \
+             "B %l1\n"                                                  \
+             "1: LDR X30, [%0]\n"                                       \
+             "RET\n"                                                    \
+             "2:\n"                                                     \
+             : : "r" (slot) : "x9", "x30", "memory" : label)
+
+/**
+ * \brief Access to a byte.
+ *
+ * \param ptr Pointer to the byte to access.
+ */
+#define mem_access(ptr)                                                  \
+    do {                                                                 \
+        volatile uint32_t val;                                           \
+        asm volatile("LDR %0, [%1]" : "=r"(val) : "r"(ptr) : "memory");  \
+        mfence();                                                        \
+        ifence();                                                        \
+    } while (0)
+
+/* ** Static functions: */
+
+/**
+ * \brief Mask for a bounds-checked index, safe under speculation.
+ * \details Compute the mask with a flag-setting compare and a conditional
+ *          subtraction (no branch to mispredict), then \sa {csdb} so the
+ *          mask is never a predicted value.
+ *
+ * \param index Index to check.
+ * \param size Size of the array.
+ * \return size_t All ones if (index < size), 0 otherwise.
+ */
+static inline size_t index_mask_nospec(size_t index, size_t size) {
+    size_t mask;
+    asm volatile("CMP %1, %2\n"
+                 "SBC %0, XZR, XZR" : "=r"(mask) : "r"(index), "r"(size) : "cc");
+    csdb();
+    return mask;
+}
+
+/**
+ * \brief Delay a value by a chain of dependent instructions.
+ * \details Add zero to the value "n" times, each addition depending on the
+ *          previous one, so that an access through the value issues "n"
+ *          cycles later.
+ *
+ * \param value Value to delay.
+ * \param n Length of the chain.
+ * \return size_t The value, unchanged.
+ */
+static inline size_t delay_chain(size_t value, size_t n) {
+    asm volatile("CBZ %1, 2f\n"
+                 "1: ADD %0, %0, XZR\n"
+                 "SUBS %1, %1, #1\n"
+                 "B.NE 1b\n"
+                 "2:" : "+r"(value), "+r"(n) : : "cc");
+    return value;
+}
+
+/** Name of the time source used by \sa {rdtsc()}. Part of the calibration
+    fingerprint, since thresholds are expressed in its units. */
+#define TIMER_BACKEND "clock_gettime"
+
+/**
+ * \brief   Read Time-Stamp Counter.
+ * \details Reads the current value of the processor's time-stamp counter. The
+ *          processor monotonically increments the time-stamp counter every
+ *          clock cycle. This function is serializing. It does necessarily wait
+ *          until all previous instructions have been executed before reading
+ *          the counter. Similarly, subsequent instructions can't begin
+ *          execution before the read operation is performed.
+ * \note To simulate the x86 rdtsc instruction, we can either use the
+ *       PMCCNTR_EL0 or an approximation. This counter require to enable PMU
+ *       access to the user-land from a kernel module. Two good approximations
+ *       are:
+ *       - clock_gettime().
+ *       - Counter thread (a thread on a separate core, which increment a
+ *         counter indefinitely).
+ *       For this implementation, we use the clock_gettime() which is enough.
+ *
+ * \warning DON'T PUT this function into a corresponding ".c" file. The reason
+ *          is that if you implement the rdtsc() into an "asm.c" file and you
+ *          link the "asm.o" object file with the "spectre.o" object file,
+ *          Spectre will badly work (no guessed byte). It doesn't seems that
+ *          the cause is the supplementary compilation/linkage step, but other
+ *          thing (the distance between the function implementation and the
+ *          code that use it ?). Thus, the function is declared static to be
+ *          compliant with the "one definition" rule. The code distance is now
+ *          fixed by the "timer" region of the linker script (\sa
+ *          {HOT_SECTION}).
+
+ * \return uint64_t 64-bit value of the counter.
+ */
+/* Unused by the units only including this header for the other primitives. */
+static HOT_PATH HOT_SECTION("timer") __attribute__((unused)) uint64_t rdtsc() {
+    /* Serialization. */
+    mfence_sys();
+    ifence();
+    /* Get the current time. */
+    struct timespec t1;
+    /* CLOCK_MONOTONIC represents the absolute elapsed wall-clock time since
+     * some arbitrary, fixed point in the past. It represents monotonic time
+     * since—as described by POSIX—"some un specified point in the past". This
+     * clock advances at one tick per tick. The important aspect of a monotonic
+     * time source is NOT the current value, but the guarantee that the time
+     * source is strictly linearly increasing, and thus useful for calculating
+     * the difference in time between two samplings. */
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    /* "res" count the number of nanoseconds. */
+    uint64_t res = t1.tv_sec * 1000 * 1000 * 1000ULL + t1.tv_nsec;
+    /* Serialization. */
+    ifence();
+    mfence_sys();
+    return res;
+}
+
+#endif /* _ASM_ARM64_H_ */
@@ -0,0 +1,258 @@
+/**
+ * \brief  x86-64 Assembly.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Contain all x86-64 assembly related stuff, with the same interface
+ *          than the ARMv8-A one (\sa {asm_arm64.h}). Used to develop and tune
+ *          the attack natively on x86-64 hosts.
+ *
+ * \warning Do not include this file directly, include "asm.h" instead.
+ */
+
+#ifndef _ASM_X86_64_H_
+#define _ASM_X86_64_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* * Documentation: */
+
+/** MFENCE -- Memory Fence
+ *
+ * Performs a serializing operation on all load-from-memory and store-to-memory
+ * instructions that were issued prior the MFENCE instruction. This
+ * serializing operation guarantees that every load and store instruction that
+ * precedes the MFENCE instruction in program order becomes globally visible
+ * before any load or store instruction that follows the MFENCE instruction.
+ * It also orders CLFLUSH with respect to loads and stores.
+ */
+
+/** LFENCE -- Load Fence
+ *
+ * Performs a serializing operation on all load-from-memory instructions that
+ * were issued prior the LFENCE instruction. LFENCE does not execute until all
+ * prior instructions have completed locally, and no later instruction begins
+ * execution until LFENCE completes. This last property makes it the
+ * speculation barrier recommended by Intel and AMD, and the closest
+ * equivalent of the ARM ISB for our usage.
+ */
+
+/** CLFLUSH -- Flush Cache Line
+ *
+ * Invalidates from every level of the cache hierarchy in the cache coherence
+ * domain the cache line that contains the linear address specified with the
+ * memory operand. If that cache line contains modified data at any level of
+ * the cache hierarchy, that data is written back to memory.
+ */
+
+/** RDTSCP -- Read Time-Stamp Counter and Processor ID
+ *
+ * Reads the current value of the processor's time-stamp counter into EDX:EAX
+ * and the IA32_TSC_AUX into ECX. The RDTSCP instruction waits until all
+ * previous instructions have been executed before reading the counter.
+ * However, subsequent instructions may begin execution before the read
+ * operation is performed.
+ */
+
+/** CMP; SBB -- Conditional mask
+ *
+ * Neither Intel nor AMD predict the carry flag consumed by SBB, so a mask
+ * computed this way is never a speculative value: there is no equivalent of
+ * the ARM CSDB, nor of the ARM SB other than LFENCE.
+ */
+
+/* * Implementation: */
+
+/* ** Macro-functions: */
+
+/**
+ * \brief   Memory barrier.
+ * \details Memory barrier that ensures that memory accesses that occur before
+ *          the function have completed before the completion of the function.
+ */
+#define mfence()                                \
+    do {                                        \
+        asm volatile("mfence" ::: "memory");    \
+    } while (0)
+
+/**
+ * \brief   Memory barrier for the system domain.
+ * \details There is no shareability domain on x86-64, same as \sa {mfence}.
+ */
+#define mfence_sys() mfence()
+
+/**
+ * \brief   Instruction barrier.
+ * \details Ensures that no instruction that come after the function in
+ *          program order begins execution before the function has completed.
+ */
+#define ifence()                                \
+    do {                                        \
+        asm volatile("lfence" ::: "memory");    \
+    } while (0)
+
+/**
+ * \brief   Flush an address from the cache.
+ * \details Invalidate the cache line from every level of the hierarchy.
+ * \warning After flushing, IMPERATIVELY use in this order:
+ *          - \sa {mfence}
+ *          - \sa {ifence}
+ *
+ * \param  pointer Virtual address to flush from the cache.
+ */
+#define flush(pointer)                                          \
+    do {                                                        \
+        asm volatile("clflush (%0)" : : "r" (pointer) : "memory"); \
+    } while (0)
+
+/**
+ * \brief   Prohibit speculation.
+ * \details By using a \sa {mfence_sys} and a \sa {ifence}, prohibit the CPU to
+ *          speculate for the instructions that come after the function.
+ */
+#define nospec()                                \
+    do {                                        \
+        mfence_sys();                           \
+        ifence();                               \
+    } while (0)
+
+/**
+ * \brief   Consumption of speculative data barrier.
+ * \details Nothing to do on x86-64 (\sa {index_mask_nospec()}), only a
+ *          compiler barrier.
+ */
+#define csdb()                                  \
+    do {                                        \
+        asm volatile("" ::: "memory");          \
+    } while (0)
+
+/**
+ * \brief   Speculation barrier.
+ * \details Same as \sa {ifence}.
+ */
+#define sb() ifence()
+
+/**
+ * \brief   Speculative store bypass barrier.
+ * \details Same as \sa {ifence}: no later load executes before the address
+ *          of the earlier stores are known.
+ */
+#define ssbb() ifence()
+
+/**
+ * \brief   Take a gem5 checkpoint.
+ * \details Issue the m5 pseudo-instruction "checkpoint" (function 0x43, no
+ *          delay nor period), encoded for the gem5 x86 decoder. Only valid
+ *          under gem5, the instruction is undefined on real hardware.
+ */
+#define m5_checkpoint()                                         \
+    do {                                                        \
+        asm volatile("xor %%edi, %%edi\n"                       \
+                     "xor %%esi, %%esi\n"                       \
+                     ".byte 0x0f, 0x04\n"                       \
+                     ".word 0x43\n"                             \
+                     ::: "rdi", "rsi", "rax", "memory", "cc");  \
+    } while (0)
+
+/**
+ * \brief   Mispredict a return.
+ * \details Call a stub which replaces its return address by the address of
+ *          the end of the macro, stored and flushed in "slot". The return
+ *          stack buffer predicts a return right after the call, where a jump
+ *          to "label" is speculatively executed until the real return
+ *          address is loaded. The red zone is preserved from the call.
+ *
+ * \param slot Pointer to a flushable cache line holding a "void *".
+ * \param label C label of the speculative target.
+ */
+#define ret_mispredict(slot, label)                                     \
+    asm goto("lea 2f(%%rip), %%rax\n"                                   \
+             "mov %%rax, (%0)\n"                                        \
+             "clflush (%0)\n"                                           \
+             "mfence\n"                                                 \
+             "lea -128(%%rsp), %%rsp\n"                                 \
+             "call 1f\n"                                                \
+             "jmp %l1\n"                                                \
+             "1: mov (%0), %%rax\n"                                     \
+             "mov %%rax, (%%rsp)\n"                                     \
+             "ret\n"                                                    \
+             "2: lea 128(%%rsp), %%rsp\n"                               \
+             : : "r" (slot) : "rax", "memory", "cc" : label)
+
+/**
+ * \brief Access to a byte.
+ *
+ * \param ptr Pointer to the byte to access.
+ */
+#define mem_access(ptr)                                                  \
+    do {                                                                 \
+        volatile uint32_t val;                                           \
+        asm volatile("movl (%1), %0" : "=r"(val) : "r"(ptr) : "memory"); \
+        mfence();                                                        \
+        ifence();                                                        \
+    } while (0)
+
+/* ** Static functions: */
+
+/**
+ * \brief Mask for a bounds-checked index, safe under speculation.
+ * \details Compute the mask with a compare and a subtraction with borrow
+ *          (no branch to mispredict).
+ *
+ * \param index Index to check.
+ * \param size Size of the array.
+ * \return size_t All ones if (index < size), 0 otherwise.
+ */
+static inline size_t index_mask_nospec(size_t index, size_t size) {
+    size_t mask;
+    asm volatile("cmp %2, %1\n"
+                 "sbb %0, %0" : "=r"(mask) : "r"(index), "r"(size) : "cc");
+    return mask;
+}
+
+/**
+ * \brief Delay a value by a chain of dependent instructions.
+ * \details Same as on ARMv8-A, with the same loop.
+ *
+ * \param value Value to delay.
+ * \param n Length of the chain.
+ * \return size_t The value, unchanged.
+ */
+static inline size_t delay_chain(size_t value, size_t n) {
+    asm volatile("test %1, %1\n"
+                 "jz 2f\n"
+                 "1: add $0, %0\n"
+                 "dec %1\n"
+                 "jnz 1b\n"
+                 "2:" : "+r"(value), "+r"(n) : : "cc");
+    return value;
+}
+
+/** Name of the time source used by \sa {rdtsc()}. Part of the calibration
+    fingerprint, since thresholds are expressed in its units. */
+#define TIMER_BACKEND "rdtscp"
+
+/**
+ * \brief   Read Time-Stamp Counter.
+ * \details Reads the current value of the processor's time-stamp counter,
+ *          fully serialized like the ARMv8-A implementation: all previous
+ *          instructions have completed before the read, and no subsequent
+ *          instruction begins before it.
+ * \warning Same warning as the ARMv8-A implementation: keep this function
+ *          static, in this header.
+ *
+ * \return uint64_t 64-bit value of the counter.
+ */
+/* Unused by the units only including this header for the other primitives. */
+static HOT_PATH HOT_SECTION("timer") __attribute__((unused)) uint64_t rdtsc() {
+    uint64_t lo, hi;
+    /* Serialization. */
+    mfence();
+    asm volatile("rdtscp" : "=a"(lo), "=d"(hi) : : "rcx");
+    /* Serialization. */
+    ifence();
+    return (hi << 32) | lo;
+}
+
+#endif /* _ASM_X86_64_H_ */
@@ -0,0 +1,137 @@
+/**
+ * \brief  Candidate set.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Restrict the possible values of a guessed byte to a known alphabet
+ *          (e.g. printable characters). Only the probe lines corresponding to
+ *          the candidates are flushed, timed and scored, which reduce the
+ *          work done by each try of the attack.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* Used for \sa {char_is_printable()}. */
+#include "util.h"
+
+#include "candidates.h"
+
+/* * Private functions: */
+
+/**
+ * \brief Test if a character belongs to the base64 alphabet.
+ *
+ * \param c The character to test.
+ * \return 1 if it belongs to the alphabet, 0 otherwise.
+ */
+static int char_is_base64(int c)
+{
+    return isalnum(c) || c == '+' || c == '/' || c == '=';
+}
+
+/**
+ * \brief Fill the membership table from an alphabet file.
+ *
+ * \param c The candidate set to fill.
+ * \param path Path to the alphabet file.
+ * \return int 0 on success, 1 if the file can't be opened.
+ */
+static int candidates_from_file(struct candidates * c, const char * path)
+{
+    FILE * f = fopen(path, "rb");
+    int byte;
+    if (!f)
+        return 1;
+    while ((byte = fgetc(f)) != EOF)
+        if (byte != '\n' && byte != '\r')
+            c->member[byte] = 1;
+    fclose(f);
+    return 0;
+}
+
+/* * Public functions: */
+
+int candidates_init(struct candidates * c, const char * charset)
+{
+    int i, mix_i;
+
+    memset(c, 0, sizeof(*c));
+    /* Fill the membership table. */
+    if (!strcmp(charset, "all")) {
+        memset(c->member, 1, sizeof(c->member));
+    } else if (!strcmp(charset, "printable")) {
+        for (i = 0; i < 256; i++)
+            c->member[i] = char_is_printable(i);
+    } else if (!strcmp(charset, "hex")) {
+        for (i = 0; i < 256; i++)
+            c->member[i] = isxdigit(i) ? 1 : 0;
+    } else if (!strcmp(charset, "base64")) {
+        for (i = 0; i < 256; i++)
+            c->member[i] = char_is_base64(i) ? 1 : 0;
+    } else if (candidates_from_file(c, charset)) {
+        fprintf(stderr, "Cannot read alphabet file \"%s\".\n", charset);
+        return 1;
+    }
+
+    /* Precompute the probing order. Order is lightly mixed up to prevent
+       stride prediction, using the same permutation than the original PoC,
+       and only the candidates are kept. */
+    for (i = 0; i < 256; i++) {
+        mix_i = ((i * 167) + 13) & 255;
+        if (c->member[mix_i])
+            c->order[c->count++] = mix_i;
+    }
+
+    /* The attack needs a best and a second-best guess. */
+    if (c->count < 2) {
+        fprintf(stderr, "Candidate set \"%s\" must contain at least 2 values.\n", charset);
+        return 1;
+    }
+    return 0;
+}
+
+int candidates_pool_init(struct candidates * c, const char * policy, int size)
+{
+    int i, n, r;
+    uint8_t tmp;
+    /* Fixed seed: the same pool is generated at each run. The generator
+       (xorshift64) is local, to keep the process-wide one untouched and the
+       contexts independent. */
+    uint64_t rng = 1;
+
+    if (!strcmp(policy, "fixed")) {
+        c->pool_size = 1;
+        memcpy(c->pool[0], c->order, c->count);
+    } else if (!strcmp(policy, "linear")) {
+        c->pool_size = 1;
+        for (i = 0, n = 0; i < 256; i++)
+            if (c->member[i])
+                c->pool[0][n++] = i;
+    } else if (!strcmp(policy, "random")) {
+        if (size <= 0 || size > CANDIDATES_POOL_MAX) {
+            fprintf(stderr, "Pool size must be in [1, %d].\n", CANDIDATES_POOL_MAX);
+            return 1;
+        }
+        c->pool_size = size;
+        for (n = 0; n < size; n++) {
+            /* Fisher-Yates shuffle of the candidates. */
+            memcpy(c->pool[n], c->order, c->count);
+            for (i = c->count - 1; i > 0; i--) {
+                rng ^= rng << 13;
+                rng ^= rng >> 7;
+                rng ^= rng << 17;
+                r = rng % (i + 1);
+                tmp = c->pool[n][i];
+                c->pool[n][i] = c->pool[n][r];
+                c->pool[n][r] = tmp;
+            }
+        }
+    } else {
+        fprintf(stderr, "Unknown ordering policy \"%s\".\n", policy);
+        return 1;
+    }
+    return 0;
+}
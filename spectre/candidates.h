@@ -0,0 +1,78 @@
+/**
+ * \brief  Candidate set.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Restrict the possible values of a guessed byte to a known alphabet
+ *          (e.g. printable characters). Only the probe lines corresponding to
+ *          the candidates are flushed, timed and scored, which reduce the
+ *          work done by each try of the attack.
+ */
+
+#ifndef _CANDIDATES_H_
+#define _CANDIDATES_H_
+
+#include <stdint.h>
+
+/* * Constants: */
+
+/** Maximum number of probing orders in the pool. */
+#define CANDIDATES_POOL_MAX (256)
+
+/* * Structures: */
+
+/**
+ * \brief Set of candidate values for a guessed byte.
+ *
+ * \details The probing orders are precomputed once, such that the attack
+ *          loop only has to walk one of the "pool" arrays, rotating over the
+ *          pool at each try.
+ */
+struct candidates
+{
+    /** Number of candidates, \in [2, 256]. */
+    int count;
+    /** member[i] is 1 if the byte i is a candidate, 0 otherwise. */
+    uint8_t member[256];
+    /** Candidates in probing order. Only the "count" first entries are
+        valid. */
+    uint8_t order[256];
+    /** Number of probing orders in the pool, \in [1, CANDIDATES_POOL_MAX]. */
+    int pool_size;
+    /** Pool of probing orders, each one being a permutation of "order". */
+    uint8_t pool[CANDIDATES_POOL_MAX][256];
+};
+
+/* * Prototypes: */
+
+/**
+ * \brief Initialize a candidate set from its name.
+ * \details Supported names are "all" (the 256 values), "printable" (\sa
+ *          {char_is_printable()}), "hex" ([0-9a-fA-F]) and "base64"
+ *          ([A-Za-z0-9+/=]). Any other name is interpreted as a file
+ *          containing the alphabet, where each byte of the file (except line
+ *          feeds and carriage returns) is a candidate.
+ *
+ * \param c The candidate set to initialize.
+ * \param charset Name of the set or path to an alphabet file.
+ * \return int 0 on success, 1 if the file can't be read or if the set
+ *             contains less than 2 candidates.
+ */
+int candidates_init(struct candidates * c, const char * charset);
+
+/**
+ * \brief Initialize the pool of probing orders of a candidate set.
+ * \details Supported policies are "fixed" (one order, the permutation of the
+ *          original PoC), "linear" (one order, ascending values, which is the
+ *          worst case for a stride prefetcher) and "random" (size random
+ *          permutations, generated with a fixed seed to keep runs
+ *          reproducible).
+ *
+ * \param c The candidate set, already initialized by \sa {candidates_init()}.
+ * \param policy Name of the ordering policy.
+ * \param size Number of permutations for the "random" policy.
+ * \return int 0 on success, 1 if the policy or the size is invalid.
+ */
+int candidates_pool_init(struct candidates * c, const char * policy, int size);
+
+#endif /* _CANDIDATES_H_ */
@@ -0,0 +1,82 @@
+/**
+ * \brief  Confusion matrix.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Analysis mode accumulating the true bytes of the secret against
+ *          the guessed ones, and the capacity achieved by the attack.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "confusion.h"
+
+void confusion_add(struct confusion * conf, uint8_t truth, uint8_t guess, int tries) {
+    conf->counts[truth][guess]++;
+    conf->samples++;
+    conf->tries += tries;
+}
+
+double confusion_mutual_info(const struct confusion * conf) {
+    /* Marginal counts of the true and of the guessed bytes. */
+    uint64_t truth[256] = {0}, guess[256] = {0};
+    double n = conf->samples, info = 0;
+
+    if (!conf->samples)
+        return 0;
+    for (int t = 0; t < 256; t++)
+        for (int g = 0; g < 256; g++) {
+            truth[t] += conf->counts[t][g];
+            guess[g] += conf->counts[t][g];
+        }
+    /* I(T; G) = sum of p(t, g) * log2(p(t, g) / (p(t) * p(g))). */
+    for (int t = 0; t < 256; t++)
+        for (int g = 0; g < 256; g++)
+            if (conf->counts[t][g])
+                info += conf->counts[t][g] / n * log2(conf->counts[t][g] * n / ((double) truth[t] * guess[g]));
+    return info;
+}
+
+int confusion_write(const struct confusion * conf, const char * path, int binary) {
+    FILE * f = fopen(path, binary ? "wb" : "w");
+    int err = 0;
+
+    if (!f) {
+        fprintf(stderr, "Cannot write confusion matrix \"%s\".\n", path);
+        return 1;
+    }
+    if (binary) {
+        err |= fwrite(CONFUSION_MAGIC, strlen(CONFUSION_MAGIC), 1, f) != 1;
+        err |= fwrite(&conf->samples, sizeof(conf->samples), 1, f) != 1;
+        err |= fwrite(&conf->tries, sizeof(conf->tries), 1, f) != 1;
+        err |= fwrite(&conf->seconds, sizeof(conf->seconds), 1, f) != 1;
+        err |= fwrite(conf->counts, sizeof(conf->counts), 1, f) != 1;
+    } else {
+        fprintf(f, "true byte,guessed byte,count\n");
+        for (int t = 0; t < 256; t++)
+            for (int g = 0; g < 256; g++)
+                if (conf->counts[t][g])
+                    fprintf(f, "%d,%d,%u\n", t, g, conf->counts[t][g]);
+    }
+    err |= fclose(f) != 0;
+    if (err)
+        fprintf(stderr, "Cannot write confusion matrix \"%s\".\n", path);
+    return err;
+}
+
+void confusion_report(int fd, const struct confusion * conf) {
+    static char * hdr = "samples,tries,seconds,bits per byte,bits per try,bits per second\n";
+    double info = confusion_mutual_info(conf);
+    char entry[256];
+
+    write(fd, hdr, strlen(hdr));
+    snprintf(entry, sizeof(entry), "%lu,%lu,%.3f,%.4f,%.6f,%.2f\n",
+             conf->samples, conf->tries, conf->seconds, info,
+             conf->tries ? info * conf->samples / conf->tries : 0,
+             conf->seconds > 0 ? info * conf->samples / conf->seconds : 0);
+    write(fd, entry, strlen(entry));
+}
@@ -0,0 +1,89 @@
+/**
+ * \brief  Confusion matrix.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Analysis mode accumulating, over all the experiments of a
+ *          campaign, the true bytes of the secret against the guessed ones.
+ *          The mutual information between them is the capacity actually
+ *          achieved by the attack, comparable between configurations, the
+ *          hardware and gem5. The matrix is dumped in CSV or in a compact
+ *          binary format.
+ */
+
+#ifndef _CONFUSION_H_
+#define _CONFUSION_H_
+
+#include <stdint.h>
+
+/* * Constants: */
+
+/** Magic number of the binary format (\sa {confusion_write()}). */
+#define CONFUSION_MAGIC "SPCM"
+
+/* * Structures: */
+
+/**
+ * \brief Confusion matrix and the cost of the guesses it holds.
+ */
+struct confusion
+{
+    /** counts[t][g]: number of times the true byte t has been guessed as
+        g. */
+    uint32_t counts[256][256];
+    /** Number of guessed bytes, tries spent to guess them and time spent, in
+        seconds. */
+    uint64_t samples;
+    uint64_t tries;
+    double seconds;
+};
+
+/* * Prototypes: */
+
+/**
+ * \brief Add one guess to a confusion matrix.
+ *
+ * \param conf The matrix.
+ * \param truth The true byte.
+ * \param guess The guessed byte.
+ * \param tries Number of tries spent by the guess.
+ */
+void confusion_add(struct confusion * conf, uint8_t truth, uint8_t guess, int tries);
+
+/**
+ * \brief Compute the mutual information between the true and the guessed
+ *        bytes.
+ * \details Estimated from the empirical joint distribution of the matrix,
+ *          thus biased upward when the samples are few compared to the cells
+ *          they spread over.
+ *
+ * \param conf The matrix.
+ * \return double Mutual information, in bits per guessed byte (0 if empty).
+ */
+double confusion_mutual_info(const struct confusion * conf);
+
+/**
+ * \brief Write a confusion matrix to a file.
+ * \details Either in CSV, one "true byte,guessed byte,count" line per
+ *          non-zero cell, or in binary: CONFUSION_MAGIC, then "samples",
+ *          "tries" and "seconds", then the 256x256 counts, in native
+ *          endianness.
+ *
+ * \param conf The matrix.
+ * \param path Path of the file.
+ * \param binary 1 for the binary format, 0 for CSV.
+ * \return int 0 on success, 1 if the file can't be written.
+ */
+int confusion_write(const struct confusion * conf, const char * path, int binary);
+
+/**
+ * \brief Print the capacity achieved by a campaign.
+ * \details One CSV line "samples,tries,seconds,bits per byte,bits per
+ *          try,bits per second" preceded by its header, on a file descriptor.
+ *
+ * \param fd The file descriptor.
+ * \param conf The matrix.
+ */
+void confusion_report(int fd, const struct confusion * conf);
+
+#endif /* _CONFUSION_H_ */
@@ -0,0 +1,283 @@
+/**
+ * \brief  Cross-core covert channel benchmark.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Measure the capacity of the Flush+Reload channel alone, without
+ *          any speculation. A sender thread transmits a known pseudo-random
+ *          bit stream, one bit per time slot: it accesses the line of the bit
+ *          value of a shared buffer during the slot. A receiver thread on
+ *          another core flushes both lines at the start of each slot, reloads
+ *          them near its end, and decodes the bit from the faster one. Both
+ *          threads follow the same clock (\sa {rdtsc()}). The slot period is
+ *          swept, and for each one the raw bandwidth, the bit error rate and
+ *          the capacity of the equivalent binary symmetric channel are
+ *          reported in CSV. This bounds what the Spectre attack can reach:
+ *          its own rate is 8 * (correct bytes) / (elapsed time).
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <argp.h>
+#include <sched.h>
+#include <pthread.h>
+
+/* Contain ARMv8 or x86-64 implementation of flush, rdtsc and [im]fence. */
+#include "asm.h"
+
+/* * Constants: */
+
+/** Keys of the options without short name. */
+#define ARG_KEY_SENDER_CORE   (0x100)
+#define ARG_KEY_RECEIVER_CORE (0x101)
+#define ARG_KEY_PERIOD_MAX    (0x102)
+#define ARG_KEY_PERIOD_MIN    (0x103)
+#define ARG_KEY_SEED          (0x104)
+
+/** Header of the results, in CSV format. */
+#define COVERT_HEADER "period,raw bandwidth,bit error rate,capacity\n"
+
+/** Distance between the lines of the bit values: one page, to keep the
+    prefetcher out. */
+#define COVERT_STRIDE 4096
+
+/** Slots waited before the first bit, to let both threads start. */
+#define COVERT_LEAD 64
+
+/* * Structures: */
+
+/** Options of the benchmark. */
+struct covert_args
+{
+    int quiet;
+    int sender_core;
+    int receiver_core;
+    int bits;
+    uint64_t period_max;
+    uint64_t period_min;
+    uint64_t seed;
+};
+
+/** State shared by the sender and the receiver, for one period. */
+struct covert_channel
+{
+    /** Lines of the bit values. */
+    uint8_t buffer[2 * COVERT_STRIDE] __attribute__((aligned(4096)));
+    /** Transmitted and received bits. */
+    uint8_t * sent;
+    uint8_t * received;
+    int bits;
+    /** Start of the first slot and length of a slot, in \sa {rdtsc()}
+        units. */
+    uint64_t start;
+    uint64_t period;
+};
+
+/** Parameter of a thread. */
+struct covert_thread
+{
+    struct covert_channel * ch;
+    int core;
+};
+
+/* * Variables: */
+
+static char doc[] = "Covert -- Bandwidth of the cross-core Flush+Reload covert channel";
+
+static struct argp_option options[] =
+    {
+     {"quiet",         'q',                   0,        0, "Don't produce the header for csv" },
+     {"bits",          'b',                   "NUMBER", 0, "Number of bits transmitted per period (default: 4096)" },
+     {"sender-core",   ARG_KEY_SENDER_CORE,   "CORE",   0, "Core of the sender thread (default: 0)" },
+     {"receiver-core", ARG_KEY_RECEIVER_CORE, "CORE",   0, "Core of the receiver thread (default: 1)" },
+     {"period-max",    ARG_KEY_PERIOD_MAX,    "TICKS",  0, "Longest slot, in rdtsc() units (default: 65536)" },
+     {"period-min",    ARG_KEY_PERIOD_MIN,    "TICKS",  0, "Shortest slot, the period is halved down to it (default: 256)" },
+     {"seed",          ARG_KEY_SEED,          "NUMBER", 0, "Seed of the transmitted bit stream (default: 1)" },
+     { 0 }
+    };
+
+/* * Functions: */
+
+/* ** Arguments: */
+
+static error_t covert_parse_opt(int key, char *arg, struct argp_state *state)
+{
+    struct covert_args *args = state->input;
+
+    switch (key)
+        {
+        case 'q':
+            args->quiet = 1;
+            break;
+        case 'b':
+            args->bits = atoi(arg);
+            if (args->bits <= 0) {
+                fprintf(stderr, "<bits> must be superior or equal to 1.\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_SENDER_CORE:
+            args->sender_core = atoi(arg);
+            break;
+        case ARG_KEY_RECEIVER_CORE:
+            args->receiver_core = atoi(arg);
+            break;
+        case ARG_KEY_PERIOD_MAX:
+            args->period_max = strtoull(arg, NULL, 0);
+            break;
+        case ARG_KEY_PERIOD_MIN:
+            args->period_min = strtoull(arg, NULL, 0);
+            if (!args->period_min) {
+                fprintf(stderr, "<period-min> must be superior or equal to 1.\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_SEED:
+            args->seed = strtoull(arg, NULL, 0);
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+        }
+    return 0;
+}
+
+/* ** Threads: */
+
+/* Pin the calling thread, only warn on failure (e.g. single-core
+   simulation). */
+static void covert_pin(int core) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        fprintf(stderr, "Cannot pin a thread on core %d.\n", core);
+}
+
+static void * covert_sender(void * data) {
+    struct covert_thread * thread = data;
+    struct covert_channel * ch = thread->ch;
+    uint64_t slot, end;
+
+    covert_pin(thread->core);
+    for (int i = 0; i < ch->bits; i++) {
+        slot = ch->start + i * ch->period;
+        end  = slot + ch->period * 3 / 4;
+        while (rdtsc() < slot)
+            ;
+        /* Keep the line cached until the receiver reloads it. */
+        while (rdtsc() < end)
+            mem_access(&ch->buffer[ch->sent[i] * COVERT_STRIDE]);
+    }
+    return NULL;
+}
+
+static void * covert_receiver(void * data) {
+    struct covert_thread * thread = data;
+    struct covert_channel * ch = thread->ch;
+    uint64_t slot, end;
+    int t0, t1;
+
+    covert_pin(thread->core);
+    for (int i = 0; i < ch->bits; i++) {
+        slot = ch->start + i * ch->period;
+        end  = slot + ch->period * 3 / 4;
+        while (rdtsc() < slot)
+            ;
+        flush(&ch->buffer[0]);
+        flush(&ch->buffer[COVERT_STRIDE]);
+        mfence();
+        while (rdtsc() < end)
+            ;
+        /* The line accessed by the sender is the faster one. */
+        t0 = reload_t(&ch->buffer[0]);
+        t1 = reload_t(&ch->buffer[COVERT_STRIDE]);
+        ch->received[i] = t1 < t0;
+    }
+    return NULL;
+}
+
+/* ** Measures: */
+
+/* Number of \sa {rdtsc()} units per second. */
+static double covert_tick_rate(void) {
+    struct timespec start, end, wait = { 0, 50 * 1000 * 1000 };
+    uint64_t t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t0 = rdtsc();
+    nanosleep(&wait, NULL);
+    t1 = rdtsc();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (t1 - t0) / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+}
+
+/* Binary entropy function, in bits. */
+static double covert_entropy(double p) {
+    return p <= 0 || p >= 1 ? 0 : -p * log2(p) - (1 - p) * log2(1 - p);
+}
+
+int main(int argc, char **argv) {
+    struct covert_args args = { 0, 0, 1, 4096, 65536, 256, 1 };
+    struct argp argp = { options, covert_parse_opt, 0, doc };
+    static struct covert_channel ch;
+    struct covert_thread sender = { &ch, 0 }, receiver = { &ch, 0 };
+    pthread_t threads[2];
+    uint64_t state;
+    double rate, ber, bandwidth;
+    char entry[256];
+    int errors;
+
+    argp_parse(&argp, argc, argv, 0, 0, &args);
+    sender.core   = args.sender_core;
+    receiver.core = args.receiver_core;
+    ch.bits     = args.bits;
+    ch.sent     = malloc(args.bits);
+    ch.received = calloc(args.bits, 1);
+    if (!ch.sent || !ch.received)
+        return 1;
+    /* Known bit stream, from a xorshift generator. */
+    state = args.seed ? args.seed : 1;
+    for (int i = 0; i < args.bits; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        ch.sent[i] = state & 1;
+    }
+    /* Back the buffer by real pages. */
+    memset(ch.buffer, 1, sizeof(ch.buffer));
+    rate = covert_tick_rate();
+
+    if (!args.quiet)
+        write(1, COVERT_HEADER, strlen(COVERT_HEADER));
+    for (uint64_t period = args.period_max; period >= args.period_min; period /= 2) {
+        ch.period = period;
+        ch.start  = rdtsc() + COVERT_LEAD * period;
+        if (pthread_create(&threads[0], NULL, covert_sender, &sender)
+            || pthread_create(&threads[1], NULL, covert_receiver, &receiver)) {
+            fprintf(stderr, "Cannot create the threads.\n");
+            return 1;
+        }
+        pthread_join(threads[0], NULL);
+        pthread_join(threads[1], NULL);
+
+        errors = 0;
+        for (int i = 0; i < args.bits; i++)
+            errors += ch.sent[i] != ch.received[i];
+        ber       = (double) errors / args.bits;
+        bandwidth = rate / period;
+        snprintf(entry, sizeof(entry), "%lu,%.0f,%.4f,%.0f\n", period, bandwidth, ber,
+                 bandwidth * (1 - covert_entropy(ber)));
+        write(1, entry, strlen(entry));
+    }
+    free(ch.sent);
+    free(ch.received);
+    return 0;
+}
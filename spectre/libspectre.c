@@ -0,0 +1,231 @@
+/**
+ * \brief  Spectre library.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Stable C API to embed the Spectre attack in another program, e.g.
+ *          to run parameter sweeps in one warmed-up process instead of
+ *          executing the command-line program for each point. The typical
+ *          usage is: create, set parameters, run (as many times as needed),
+ *          destroy. Built as "libspectre.so" by "make lib".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "spectre_pht_sa_ip.h"
+#include "candidates.h"
+#include "experiment.h"
+#include "util.h"
+
+#include "libspectre.h"
+
+/* * Constants: */
+
+/** Maximum length of a string parameter. */
+#define PARAM_STR_SIZE (256)
+
+/* * Structures: */
+
+/** Type of a parameter. */
+enum param_type
+{
+    /** Integer, >= min. */
+    PARAM_INT,
+    /** Integer, 0 or 1. */
+    PARAM_FLAG,
+    /** String of length >= min, copied into the handle. */
+    PARAM_STR,
+    /** Floating-point number, >= min. */
+    PARAM_DOUBLE,
+    /** Unsigned long integer. */
+    PARAM_ULONG,
+};
+
+/** Where a parameter goes. */
+enum param_dirty
+{
+    /** Only read by the attack. */
+    DIRTY_NONE        = 0,
+    /** Require to rebuild the candidate set. */
+    DIRTY_CANDIDATES  = 1 << 0,
+    /** Require a new calibration. */
+    DIRTY_CALIBRATION = 1 << 1,
+    /** Require to reinitialize the channel. */
+    DIRTY_CHANNEL     = 1 << 2,
+    /** Require to reselect the variant or the victim. */
+    DIRTY_VICTIM      = 1 << 3,
+};
+
+/** Description of a parameter, mapped to a field of \sa {struct arguments}. */
+struct param
+{
+    const char * name;
+    size_t offset;
+    enum param_type type;
+    int min;
+    /** Maximum of the numeric parameters, none if not greater than min. */
+    int max;
+    int dirty;
+    /** For strings, offset of the storage into \sa {struct libspectre}. */
+    size_t storage;
+};
+
+struct libspectre
+{
+    /** The attack context. Its "args" field holds the parameters. */
+    struct spectre_ctx * ctx;
+    /** Candidate set used by the context. */
+    struct candidates candidates;
+    /** Calibration, kept between runs. */
+    struct calibration calibration;
+    /** Bitmask of \sa {enum param_dirty}. */
+    int dirty;
+    /** Storage of the string parameters. */
+    char charset[PARAM_STR_SIZE];
+    char order[PARAM_STR_SIZE];
+    char calibration_cache[PARAM_STR_SIZE];
+    char channel[PARAM_STR_SIZE];
+    char mitigation[PARAM_STR_SIZE];
+    char variant[PARAM_STR_SIZE];
+};
+
+/* * Variables: */
+
+/** Supported parameters. */
+static const struct param params[] =
+    {
+     {"tries",             offsetof(struct arguments, tries),             PARAM_INT,  1, 0, DIRTY_NONE},
+     {"loops",             offsetof(struct arguments, loops),             PARAM_INT,  1, 0, DIRTY_NONE},
+     {"cache_threshold",   offsetof(struct arguments, cache_threshold),   PARAM_INT,  0, 0, DIRTY_CALIBRATION},
+     {"charset",           offsetof(struct arguments, charset),           PARAM_STR,  1, 0, DIRTY_CANDIDATES,  offsetof(struct libspectre, charset)},
+     {"top-k",             offsetof(struct arguments, top_k),             PARAM_INT,  0, 0, DIRTY_NONE},
+     {"sample",            offsetof(struct arguments, sample),            PARAM_INT,  0, 0, DIRTY_NONE},
+     {"sweep",             offsetof(struct arguments, sweep),             PARAM_INT,  1, 0, DIRTY_NONE},
+     {"per-line",          offsetof(struct arguments, per_line),          PARAM_FLAG, 0, 0, DIRTY_CALIBRATION},
+     {"order",             offsetof(struct arguments, order),             PARAM_STR,  1, 0, DIRTY_CANDIDATES,  offsetof(struct libspectre, order)},
+     {"pool",              offsetof(struct arguments, pool),              PARAM_INT,  1, 0, DIRTY_CANDIDATES},
+     {"calibration-cache", offsetof(struct arguments, calibration_cache), PARAM_STR,  0, 0, DIRTY_CALIBRATION, offsetof(struct libspectre, calibration_cache)},
+     {"channel",           offsetof(struct arguments, channel),           PARAM_STR,  2, 0, DIRTY_CHANNEL | DIRTY_CALIBRATION, offsetof(struct libspectre, channel)},
+     {"sim-hit-rate",      offsetof(struct arguments, sim_hit_rate),      PARAM_DOUBLE, 0, 1, DIRTY_CHANNEL},
+     {"sim-fp-rate",       offsetof(struct arguments, sim_fp_rate),       PARAM_DOUBLE, 0, 1, DIRTY_CHANNEL},
+     {"sim-noise",         offsetof(struct arguments, sim_noise),         PARAM_DOUBLE, 0, 0, DIRTY_CHANNEL | DIRTY_CALIBRATION},
+     {"sim-seed",          offsetof(struct arguments, sim_seed),          PARAM_ULONG,  0, 0, DIRTY_CHANNEL},
+     {"mitigation",        offsetof(struct arguments, mitigation),        PARAM_STR,  1, 0, DIRTY_VICTIM,      offsetof(struct libspectre, mitigation)},
+     {"variant",           offsetof(struct arguments, variant),           PARAM_STR,  1, 0, DIRTY_VICTIM,      offsetof(struct libspectre, variant)},
+     {"op-distance",       offsetof(struct arguments, op_distance),       PARAM_ULONG,  0, 0, DIRTY_VICTIM},
+     {"victim-bench",      offsetof(struct arguments, victim_bench),      PARAM_INT,  0, 0, DIRTY_NONE},
+     {"stl-delay",         offsetof(struct arguments, stl_delay),         PARAM_INT,  0, 0, DIRTY_NONE},
+     { 0 }
+    };
+
+/* * Functions: */
+
+libspectre_t * libspectre_create(void) {
+    struct arguments args;
+    libspectre_t * h = calloc(1, sizeof(*h));
+
+    if (!h)
+        return NULL;
+    arg_init(&args);
+    /* String parameters point into the handle, to be able to change them. */
+    snprintf(h->charset, sizeof(h->charset), "%s", args.charset);
+    snprintf(h->order, sizeof(h->order), "%s", args.order);
+    snprintf(h->channel, sizeof(h->channel), "%s", args.channel);
+    snprintf(h->mitigation, sizeof(h->mitigation), "%s", args.mitigation);
+    snprintf(h->variant, sizeof(h->variant), "%s", args.variant);
+    args.charset    = h->charset;
+    args.order      = h->order;
+    args.channel    = h->channel;
+    args.mitigation = h->mitigation;
+    args.variant    = h->variant;
+    if (!(h->ctx = spectre_ctx_create(&args, &h->candidates))) {
+        free(h);
+        return NULL;
+    }
+    h->dirty = DIRTY_CANDIDATES | DIRTY_CALIBRATION;
+    return h;
+}
+
+int libspectre_set_param(libspectre_t * h, const char * name, const char * value) {
+    const struct param * p;
+    char * field, * storage, * end;
+    long val;
+    unsigned long uval;
+    double dval;
+
+    for (p = params; p->name && strcmp(p->name, name); p++)
+        ;
+    if (!p->name)
+        return 1;
+    field = (char *) &h->ctx->args + p->offset;
+
+    if (p->type == PARAM_STR) {
+        storage = (char *) h + p->storage;
+        if (strlen(value) < p->min || strlen(value) >= PARAM_STR_SIZE)
+            return 1;
+        strcpy(storage, value);
+        /* An empty string disables an optional parameter. */
+        *(char **) field = *value ? storage : NULL;
+    } else if (p->type == PARAM_DOUBLE) {
+        dval = strtod(value, &end);
+        if (*value == '\0' || *end != '\0' || dval < p->min || (p->max > p->min && dval > p->max))
+            return 1;
+        *(double *) field = dval;
+    } else if (p->type == PARAM_ULONG) {
+        uval = strtoul(value, &end, 0);
+        if (*value == '\0' || *end != '\0')
+            return 1;
+        *(unsigned long *) field = uval;
+    } else {
+        val = strtol(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || val < p->min || (p->max > p->min && val > p->max)
+            || (p->type == PARAM_FLAG && val > 1))
+            return 1;
+        *(int *) field = (int) val;
+    }
+    h->dirty |= p->dirty;
+    return 0;
+}
+
+int libspectre_run(libspectre_t * h, struct libspectre_result * result) {
+    struct experiment_stats stats;
+    struct arguments * args = &h->ctx->args;
+
+    if (h->dirty & DIRTY_CANDIDATES) {
+        if (candidates_init(&h->candidates, args->charset)
+            || candidates_pool_init(&h->candidates, args->order, args->pool))
+            return 1;
+    }
+    if ((h->dirty & DIRTY_VICTIM) && spectre_ctx_variant_init(h->ctx))
+        return 1;
+    if (h->dirty & DIRTY_CHANNEL) {
+        if ((strcmp(args->channel, "hw") && strcmp(args->channel, "sim"))
+            || spectre_ctx_channel_init(h->ctx))
+            return 1;
+    }
+    experiment_prepare(h->ctx);
+    /* Contrary to the command-line program, calibrate only once. */
+    if (h->dirty & DIRTY_CALIBRATION)
+        experiment_calibrate(h->ctx, &h->calibration, 1);
+    h->dirty = 0;
+    experiment_run(h->ctx, &stats);
+
+    result->total_bytes       = stats.total_bytes;
+    result->correct_bytes     = stats.correct_bytes;
+    result->score_sum         = stats.score_sum;
+    result->elapsed           = stats.elapsed;
+    result->cache_misses      = stats.cache_misses;
+    result->branch_misses     = stats.branch_misses;
+    result->false_hit_rate    = stats.false_hit_rate;
+    result->victim_latency    = stats.victim_latency;
+    result->victim_throughput = stats.victim_throughput;
+    return 0;
+}
+
+void libspectre_destroy(libspectre_t * h) {
+    spectre_ctx_destroy(h->ctx);
+    free(h);
+}
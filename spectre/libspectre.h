@@ -0,0 +1,87 @@
+/**
+ * \brief  Spectre library.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Stable C API to embed the Spectre attack in another program, e.g.
+ *          to run parameter sweeps in one warmed-up process instead of
+ *          executing the command-line program for each point. The typical
+ *          usage is: create, set parameters, run (as many times as needed),
+ *          destroy. Built as "libspectre.so" by "make lib".
+ *
+ * \warning A handle must not be used by several threads at the same time,
+ *          but several handles can: each one holds its own context and
+ *          parameters, and the performance counters of a run are local to
+ *          it and count its thread only (\sa {struct perf_counters}).
+ */
+
+#ifndef _LIBSPECTRE_H_
+#define _LIBSPECTRE_H_
+
+#include <stdint.h>
+
+/* * Structures: */
+
+/** Opaque handle to an attack context and its parameters. */
+typedef struct libspectre libspectre_t;
+
+/**
+ * \brief Result of one run, same fields as the CSV output of the
+ *        command-line program.
+ */
+struct libspectre_result
+{
+    int total_bytes;
+    int correct_bytes;
+    int score_sum;
+    uint64_t elapsed;
+    uint64_t cache_misses;
+    uint64_t branch_misses;
+    double false_hit_rate;
+    double victim_latency;
+    double victim_throughput;
+};
+
+/* * Prototypes: */
+
+/**
+ * \brief Create a handle with the default parameters of the command-line
+ *        program.
+ *
+ * \return libspectre_t* The handle, or NULL on allocation failure.
+ */
+libspectre_t * libspectre_create(void);
+
+/**
+ * \brief Set a parameter.
+ * \details Names are the long names of the command-line options (e.g.
+ *          "tries", "loops", "cache_threshold", "charset", "top-k", "sample",
+ *          "sweep", "per-line", "order", "pool", "calibration-cache"), and
+ *          values are given as strings. Changing a parameter which
+ *          influences the calibration triggers a new one on the next run.
+ *
+ * \param h The handle.
+ * \param name Name of the parameter.
+ * \param value Value of the parameter. The string is copied.
+ * \return int 0 on success, 1 if the name is unknown or the value invalid.
+ */
+int libspectre_set_param(libspectre_t * h, const char * name, const char * value);
+
+/**
+ * \brief Read the whole secret once.
+ *
+ * \param h The handle.
+ * \param result Structure where to store the result.
+ * \return int 0 on success, 1 if the parameters are inconsistent (e.g. an
+ *             invalid candidate set).
+ */
+int libspectre_run(libspectre_t * h, struct libspectre_result * result);
+
+/**
+ * \brief Destroy a handle.
+ *
+ * \param h The handle to free.
+ */
+void libspectre_destroy(libspectre_t * h);
+
+#endif /* _LIBSPECTRE_H_ */
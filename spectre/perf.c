@@ -25,11 +25,6 @@
 
 #include "perf.h"
 
-/** File descriptor used to read cache miss counter. */
-static int perf_fd_cache_miss;
-/** File descriptor used to read mispredicted branches counter. */
-static int perf_fd_branch_miss;
-
 /**
  * \brief Initialize a "perf_event_attr", ready to be passed to "perf_event_open()".
  *
@@ -49,41 +44,53 @@ static void perf_attr_init(struct perf_event_attr * attr, uint64_t config)
     attr->exclude_callchain_kernel = 1;
 }
 
-void perf_init() {
+/**
+ * \brief Read a counter.
+ *
+ * \param fd File descriptor of the counter, -1 if not opened.
+ * \return uint64_t Value of the counter, 0 if not opened or unreadable.
+ */
+static uint64_t perf_read(int fd) {
+    uint64_t result = 0;
+    if (fd != -1 && read(fd, &result, sizeof(result)) != sizeof(result))
+        result = 0;
+    return result;
+}
+
+void perf_init(struct perf_counters * counters) {
     /* Initialize our perf_event_attr, representing one counter to be read. */
-    static struct perf_event_attr attr_cache_miss;
+    struct perf_event_attr attr_cache_miss = {0};
     /* To use with real ARM hardware: */
     perf_attr_init(&attr_cache_miss, PERF_COUNT_HW_CACHE_MISSES);
     /* To use with gem5 full-system ARM: */
     // perf_attr_init(&attr_cache_miss, 0x33);
     /* Open the file descriptor corresponding to this counter. The counter
        should start at this moment. */
-    if ((perf_fd_cache_miss = syscall(__NR_perf_event_open, &attr_cache_miss, 0, -1, -1, 0)) == -1)
-        fprintf(stderr, "perf_event_open fail %d %d: %s\n", perf_fd_cache_miss, errno, strerror(errno));
+    if ((counters->fd_cache_miss = syscall(__NR_perf_event_open, &attr_cache_miss, 0, -1, -1, 0)) == -1)
+        fprintf(stderr, "perf_event_open fail %d %d: %s\n", counters->fd_cache_miss, errno, strerror(errno));
         
     /* Same here. */
-    static struct perf_event_attr attr_branch_miss;
+    struct perf_event_attr attr_branch_miss = {0};
     /* To use with real ARM hardware: */
     perf_attr_init(&attr_branch_miss,PERF_COUNT_HW_BRANCH_MISSES);
     /* To use with gem5 full-system ARM: */
     // perf_attr_init(&attr_branch_miss, 0x10);
-    if ((perf_fd_branch_miss = syscall(__NR_perf_event_open, &attr_branch_miss, 0, -1, -1, 0)) == -1)
-        fprintf(stderr, "perf_event_open fail %d %d: %s\n", perf_fd_branch_miss, errno, strerror(errno));
+    if ((counters->fd_branch_miss = syscall(__NR_perf_event_open, &attr_branch_miss, 0, -1, -1, 0)) == -1)
+        fprintf(stderr, "perf_event_open fail %d %d: %s\n", counters->fd_branch_miss, errno, strerror(errno));
 }
 
-void perf_close() {
-    close(perf_fd_cache_miss);
-    close(perf_fd_branch_miss);
+void perf_close(struct perf_counters * counters) {
+    if (counters->fd_cache_miss != -1)
+        close(counters->fd_cache_miss);
+    if (counters->fd_branch_miss != -1)
+        close(counters->fd_branch_miss);
+    counters->fd_cache_miss = counters->fd_branch_miss = -1;
 }
 
-uint64_t perf_read_cache_miss() {
-    uint64_t result;
-    read(perf_fd_cache_miss, &result, sizeof(result));
-    return result;
+uint64_t perf_read_cache_miss(struct perf_counters * counters) {
+    return perf_read(counters->fd_cache_miss);
 }
 
-uint64_t perf_read_branch_miss() {
-    uint64_t result;
-    read(perf_fd_branch_miss, &result, sizeof(result));
-    return result;
+uint64_t perf_read_branch_miss(struct perf_counters * counters) {
+    return perf_read(counters->fd_branch_miss);
 }
@@ -13,29 +13,56 @@
 
 #include <stdint.h>
 
+/* * Structures: */
+
+/**
+ * \brief Counters of one measure.
+ * \details They count the thread which initialized them, so each thread
+ *          measuring at the same time has its own.
+ */
+struct perf_counters
+{
+    /** File descriptor used to read cache miss counter, -1 if not opened. */
+    int fd_cache_miss;
+    /** File descriptor used to read mispredicted branches counter, -1 if
+        not opened. */
+    int fd_branch_miss;
+};
+
+/* * Prototypes: */
+
 /**
  * \brief Initialize the PMU's counters with the perf_event interface.
- * \details Counters are initialized to zero and started as soon as they can.
+ * \details Counters are initialized to zero and started as soon as they can,
+ *          for the calling thread.
+ *
+ * \param counters The counters to open.
  */
-void perf_init();
+void perf_init(struct perf_counters * counters);
 
 /**
  * \brief Stop the PMU's counters.
+ *
+ * \param counters The counters to close.
  */
-void perf_close();
+void perf_close(struct perf_counters * counters);
 
 /**
  * \brief Get the number of cache miss since the initialization.
  *
- * \return uint64_t (long unsigned int) Value of the cache miss counter.
+ * \param counters The counters to read.
+ * \return uint64_t (long unsigned int) Value of the cache miss counter, 0 if
+ *         not opened.
  */
-uint64_t perf_read_cache_miss();
+uint64_t perf_read_cache_miss(struct perf_counters * counters);
 
 /**
  * \brief Get the number of mispredicted branches since the initialization.
  *
- * \return uint64_t (long unsigned int) Value of the mispredicted branches counter.
+ * \param counters The counters to read.
+ * \return uint64_t (long unsigned int) Value of the mispredicted branches
+ *         counter, 0 if not opened.
  */
-uint64_t perf_read_branch_miss();
+uint64_t perf_read_branch_miss(struct perf_counters * counters);
 
 #endif /* _PERF_H_ */
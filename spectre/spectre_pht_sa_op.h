@@ -0,0 +1,88 @@
+/**
+ * \brief  Spectre PHT-SA-OP.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details This file contain a Spectre attack targeting the Pattern History
+ *          Table (Spectre-v1), in a same address-space and an out-of-place
+ *          training. The training runs don't call the PHT victim but its
+ *          shadow: a clone of the read-only image of the program (code and
+ *          constants) mapped at a given distance, whose bounds check branch
+ *          aliases the one of the victim in the PHT. Only the attack runs call
+ *          the victim. The distance is either given, or searched over the
+ *          powers of two, which also measures the index hashing of the PHT. It
+ *          shares the context, the victims, the receiver and the statistics
+ *          of the in-place variant (\sa {spectre_pht_sa_ip.h}, \sa
+ *          {receiver.h}).
+ */
+
+#ifndef _SPECTRE_PHT_SA_OP_H_
+#define _SPECTRE_PHT_SA_OP_H_
+
+#include <stddef.h>
+
+/* Used for \sa {struct spectre_ctx}. */
+#include "spectre_pht_sa_ip.h"
+
+/* * Constants: */
+
+/** Range of the searched distances of the shadow, as powers of two. The
+    smallest ones overlap the program and are skipped. */
+#define OP_SEARCH_SHIFT_MIN 12
+#define OP_SEARCH_SHIFT_MAX 36
+/** Number of bytes of the secret read to score one distance. */
+#define OP_SEARCH_BYTES 4
+
+/* * Prototypes: */
+
+/**
+ * \brief (Re)initialize the shadow of the current PHT victim.
+ * \details Release the previous shadow, then clone the image at
+ *          "args.op_distance" bytes, or schedule a search of the distance
+ *          (\sa {spectre_pht_sa_op_search()}) if it is 0. Until a shadow is
+ *          placed, the training runs call the victim itself (in-place
+ *          training). Called by \sa {spectre_ctx_variant_init()}.
+ *
+ * \param ctx The attack context, whose victim is selected.
+ * \return int 0 on success, 1 if the image can't be cloned at the given
+ *             distance.
+ */
+int spectre_pht_sa_op_init(struct spectre_ctx * ctx);
+
+/**
+ * \brief Search the distance of the shadow, if scheduled.
+ * \details Read OP_SEARCH_BYTES bytes of the secret with the in-place
+ *          training, as a baseline, then with the image cloned at each power
+ *          of two distance which is free in the address space. Keep the
+ *          distance reading the most correct bytes, the hits on the secret
+ *          lines breaking the ties, if it reads more bytes than the baseline.
+ *          Otherwise the training stays in-place. The scores of all the
+ *          distances (0 for the baseline) are printed on stderr in verbose
+ *          mode. Needs
+ *          the thresholds of the context (\sa {experiment_calibrate()}).
+ *          Nothing is done with the simulated channel.
+ *
+ * \param ctx The attack context.
+ */
+void spectre_pht_sa_op_search(struct spectre_ctx * ctx);
+
+/**
+ * \brief Unmap the shadow of the context, if any.
+ *
+ * \param ctx The attack context.
+ */
+void spectre_pht_sa_op_release(struct spectre_ctx * ctx);
+
+/**
+ * \brief Train the shadow and attack the PHT victim, once.
+ * \details Same as \sa {spectre_pht_sa_ip_attack()}, but the training runs
+ *          call the shadow instead of the victim. Used as "ctx->attack" by
+ *          the receiver (\sa {receiver_read()}).
+ *
+ * \param ctx The attack context.
+ * \param training_x The legit offset given to array1.
+ * \param malicious_x The offset given to array1 during the attack.
+ */
+void spectre_pht_sa_op_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x);
+
+#endif /* _SPECTRE_PHT_SA_OP_H_ */
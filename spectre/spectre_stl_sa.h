@@ -0,0 +1,52 @@
+/**
+ * \brief  Spectre STL-SA.
+ * \author Pierre AYOUB -- IRISA, CNRS
+ * \date   2020
+ *
+ * \details This file contain a Spectre attack targeting the memory
+ *          disambiguation (Spectre-v4, speculative store bypass), in a same
+ *          address-space. The victim stores a legit offset through a pointer
+ *          loaded from a flushed line, then loads the offset back. While the
+ *          address of the store is unknown, the load is predicted not to
+ *          alias and reads the stale offset left by the attacker, which is
+ *          used to encode array1[offset] into array2. The load can be
+ *          delayed by "args.stl_delay" dependent instructions (\sa
+ *          {delay_chain()}): the delay from which the leak stops gives the
+ *          store-to-load forwarding window. It shares the context,
+ *          the receiver and the statistics of the PHT variant (\sa
+ *          {spectre_pht_sa_ip.h}, \sa {receiver.h}).
+ */
+
+#ifndef _SPECTRE_STL_SA_H_
+#define _SPECTRE_STL_SA_H_
+
+#include <stddef.h>
+
+/* Used for \sa {struct spectre_ctx}. */
+#include "spectre_pht_sa_ip.h"
+
+/* * Prototypes: */
+
+/**
+ * \brief Select the STL victim hardened by "args.mitigation".
+ * \details Either none or ssbb (\sa {ssbb}), between the store and the load.
+ *
+ * \param ctx The attack context, whose "victim" and "victim_bare" are set.
+ * \return int 0 on success, 1 if the mitigation is unknown.
+ */
+int spectre_stl_sa_victim_init(struct spectre_ctx * ctx);
+
+/**
+ * \brief Attack the STL victim, once.
+ * \details Call the victim "loops" times. Before each call, the stale offset
+ *          is set to the malicious one, while the victim stores the legit
+ *          one. Used as "ctx->attack" by the receiver (\sa
+ *          {receiver_read()}).
+ *
+ * \param ctx The attack context.
+ * \param training_x The legit offset stored by the victim.
+ * \param malicious_x The stale offset read speculatively.
+ */
+void spectre_stl_sa_attack(struct spectre_ctx * ctx, size_t training_x, size_t malicious_x);
+
+#endif /* _SPECTRE_STL_SA_H_ */
@@ -7,23 +7,44 @@
  * formatting.
  */
 
+/* For sched_getcpu(). */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <argp.h>
 #include <assert.h>
+#include <sched.h>
 
 /* Used to compute cache threshold. */
 #include "asm.h"
 
 #include "util.h"
 
-/* * Public variables: */
+/* * Constants: */
+
+/** Keys of the options without short name. They have to be outside of the
+    printable ASCII range. */
+#define ARG_KEY_SAMPLE (0x100)
+#define ARG_KEY_SWEEP  (0x101)
+#define ARG_KEY_POOL   (0x102)
+#define ARG_KEY_CHANNEL      (0x103)
+#define ARG_KEY_SIM_HIT_RATE (0x104)
+#define ARG_KEY_SIM_FP_RATE  (0x105)
+#define ARG_KEY_SIM_NOISE    (0x106)
+#define ARG_KEY_SIM_SEED     (0x107)
+#define ARG_KEY_MITIGATION   (0x108)
+#define ARG_KEY_VICTIM_BENCH (0x109)
+#define ARG_KEY_VARIANT      (0x10a)
+#define ARG_KEY_OP_DISTANCE  (0x10b)
+#define ARG_KEY_CONFUSION    (0x10c)
+#define ARG_KEY_CONFUSION_FORMAT (0x10d)
+#define ARG_KEY_CHECKPOINT   (0x10e)
+#define ARG_KEY_STL_DELAY    (0x10f)
 
-/* The assignation to 0 is just initialization. The value will be computed at
-   runtime by \sa {flush_reload_threshold()} function, or specified on the
-   command-line. */
-int CACHE_HIT_THRESHOLD = 0;
+/** Maximum length of a platform fingerprint. */
+#define FINGERPRINT_SIZE (256)
 
 /* * Variables: */
 
@@ -127,6 +148,113 @@ static error_t arg_parse_opt (int key, char *arg, struct argp_state *state)
                 argp_usage(state);
             }
             break;
+        case 'a':
+            arguments->charset = arg;
+            break;
+        case 'k':
+            arguments->top_k = atoi(arg);
+            if (arguments->top_k < 0) {
+                fprintf(stderr, "<top_k> must be superior or equal to 0.\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_SAMPLE:
+            arguments->sample = atoi(arg);
+            if (arguments->sample < 0) {
+                fprintf(stderr, "<sample> must be superior or equal to 0.\n");
+                argp_usage(state);
+            }
+            break;
+        case 'p':
+            arguments->per_line = 1;
+            break;
+        case ARG_KEY_CHANNEL:
+            arguments->channel = arg;
+            if (strcmp(arg, "hw") && strcmp(arg, "sim")) {
+                fprintf(stderr, "<channel> must be \"hw\" or \"sim\".\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_SIM_HIT_RATE:
+            arguments->sim_hit_rate = atof(arg);
+            if (arguments->sim_hit_rate < 0 || arguments->sim_hit_rate > 1) {
+                fprintf(stderr, "<sim-hit-rate> must be in [0, 1].\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_SIM_FP_RATE:
+            arguments->sim_fp_rate = atof(arg);
+            if (arguments->sim_fp_rate < 0 || arguments->sim_fp_rate > 1) {
+                fprintf(stderr, "<sim-fp-rate> must be in [0, 1].\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_SIM_NOISE:
+            arguments->sim_noise = atof(arg);
+            if (arguments->sim_noise < 0) {
+                fprintf(stderr, "<sim-noise> must be superior or equal to 0.\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_SIM_SEED:
+            arguments->sim_seed = strtoul(arg, NULL, 0);
+            break;
+        case ARG_KEY_MITIGATION:
+            arguments->mitigation = arg;
+            break;
+        case ARG_KEY_VARIANT:
+            arguments->variant = arg;
+            break;
+        case ARG_KEY_OP_DISTANCE:
+            arguments->op_distance = strtoul(arg, NULL, 0);
+            break;
+        case ARG_KEY_CONFUSION:
+            arguments->confusion = arg;
+            break;
+        case ARG_KEY_CONFUSION_FORMAT:
+            if (strcmp(arg, "csv") && strcmp(arg, "bin")) {
+                fprintf(stderr, "<confusion-format> must be csv or bin.\n");
+                argp_usage(state);
+            }
+            arguments->confusion_format = arg;
+            break;
+        case ARG_KEY_CHECKPOINT:
+            arguments->checkpoint = 1;
+            break;
+        case ARG_KEY_STL_DELAY:
+            arguments->stl_delay = atoi(arg);
+            if (arguments->stl_delay < 0) {
+                fprintf(stderr, "<stl-delay> must be superior or equal to 0.\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_VICTIM_BENCH:
+            arguments->victim_bench = atoi(arg);
+            if (arguments->victim_bench < 0) {
+                fprintf(stderr, "<victim-bench> must be superior or equal to 0.\n");
+                argp_usage(state);
+            }
+            break;
+        case 'C':
+            arguments->calibration_cache = arg;
+            break;
+        case 'o':
+            arguments->order = arg;
+            break;
+        case ARG_KEY_POOL:
+            arguments->pool = atoi(arg);
+            if (arguments->pool <= 0) {
+                fprintf(stderr, "<pool> must be superior to 0.\n");
+                argp_usage(state);
+            }
+            break;
+        case ARG_KEY_SWEEP:
+            arguments->sweep = atoi(arg);
+            if (arguments->sweep <= 0) {
+                fprintf(stderr, "<sweep> must be superior to 0.\n");
+                argp_usage(state);
+            }
+            break;
 
         /* End of parsing. */
         case ARGP_KEY_END:
@@ -145,6 +273,27 @@ void arg_init(struct arguments *args)
     args->tries           = 999;
     args->loops           = 30;
     args->cache_threshold = 0;
+    args->charset         = "all";
+    args->top_k           = 0;
+    args->sample          = 8;
+    args->sweep           = 16;
+    args->order           = "fixed";
+    args->pool            = 64;
+    args->per_line        = 0;
+    args->calibration_cache = NULL;
+    args->channel         = "hw";
+    args->sim_hit_rate    = 0.5;
+    args->sim_fp_rate     = 0.01;
+    args->sim_noise       = 10;
+    args->sim_seed        = 1;
+    args->mitigation      = "none";
+    args->victim_bench    = 0;
+    args->variant         = "pht";
+    args->op_distance     = 0;
+    args->confusion       = NULL;
+    args->confusion_format = "csv";
+    args->checkpoint      = 0;
+    args->stl_delay       = 0;
 }
 
 void arg_parse(int argc, char **argv, struct arguments *arguments)
@@ -172,6 +321,27 @@ void arg_parse(int argc, char **argv, struct arguments *arguments)
          {"tries",           't', "NUMBER", 0, "Number of attempts to guess a secret byte (default: 999)" },
          {"loops",           'l', "NUMBER", 0, "Number of loops (training and attack) per attempts (default: 30)" },
          {"cache_threshold", 'c', "NUMBER", 0, "Cache threshold separating hit and miss (default: automatically computed)" },
+         {"charset",         'a', "SET",    0, "Candidate values of a guessed byte: all, printable, hex, base64 or an alphabet file (default: all)" },
+         {"top-k",           'k', "NUMBER", 0, "Adaptive probing: number of best candidates probed once a leader emerges (default: 0, disabled)" },
+         {"sample",          ARG_KEY_SAMPLE, "NUMBER", 0, "Adaptive probing: number of other candidates probed per try (default: 8)" },
+         {"sweep",           ARG_KEY_SWEEP,  "NUMBER", 0, "Adaptive probing: period of full sweeps, in tries (default: 16)" },
+         {"per-line",        'p', 0,        0, "Compute one cache threshold per probe line (ignored if --cache_threshold is given)" },
+         {"calibration-cache", 'C', "FILE", 0, "Reuse the calibration stored in FILE if it matches the platform, otherwise compute and store it" },
+         {"order",           'o', "POLICY", 0, "Probing order: fixed, linear or random (default: fixed)" },
+         {"pool",            ARG_KEY_POOL,   "NUMBER", 0, "Number of permutations rotated by the random probing order (default: 64)" },
+         {"channel",         ARG_KEY_CHANNEL,      "NAME",   0, "Covert channel: hw (real cache) or sim (software model of the pht variant) (default: hw)" },
+         {"sim-hit-rate",    ARG_KEY_SIM_HIT_RATE, "PROB",   0, "Simulated channel: probability that a mispredicted access caches its line (default: 0.5)" },
+         {"sim-fp-rate",     ARG_KEY_SIM_FP_RATE,  "PROB",   0, "Simulated channel: probability that a probe of an uncached line hits (default: 0.01)" },
+         {"sim-noise",       ARG_KEY_SIM_NOISE,    "NUMBER", 0, "Simulated channel: standard deviation of the latency noise (default: 10)" },
+         {"sim-seed",        ARG_KEY_SIM_SEED,     "NUMBER", 0, "Simulated channel: seed of the random generator (default: 1)" },
+         {"variant",         ARG_KEY_VARIANT,      "NAME",   0, "Spectre variant: pht (v1, bounds check bypass), pht-op (v1, out-of-place training), btb (v2, branch target injection), rsb (ret2spec) or stl (v4, speculative store bypass) (default: pht)" },
+         {"op-distance",     ARG_KEY_OP_DISTANCE,  "BYTES",  0, "Out-of-place training: distance between the victim and its shadow, multiple of the page size (default: 0, searched)" },
+         {"confusion",       ARG_KEY_CONFUSION,    "FILE",   0, "Analysis mode: accumulate the confusion matrix of the true and guessed bytes over all the experiments, write it to FILE and print the mutual information on stderr" },
+         {"confusion-format", ARG_KEY_CONFUSION_FORMAT, "FORMAT", 0, "Format of the confusion matrix: csv or bin (default: csv)" },
+         {"mitigation",      ARG_KEY_MITIGATION,   "NAME",   0, "Mitigation of the victim: none, barrier, csdb, sb, mask or slh for the PHT ones, none or ssbb for the STL one, none for the BTB and RSB ones (default: none)" },
+         {"stl-delay",       ARG_KEY_STL_DELAY,    "NUMBER", 0, "STL variant: number of dependent instructions delaying the load after the store, to sweep the store-to-load forwarding window (default: 0)" },
+         {"checkpoint",      ARG_KEY_CHECKPOINT,   0,        0, "Under gem5, take a checkpoint once the victim is set up, the thresholds are calibrated and the out-of-place shadow is placed, for the restored simulations to start from there" },
+         {"victim-bench",    ARG_KEY_VICTIM_BENCH, "NUMBER", 0, "Measure the latency and throughput of the victim over NUMBER calls per experiment (default: 0, disabled)" },
          { 0 }
         };
 
@@ -183,34 +353,218 @@ void arg_parse(int argc, char **argv, struct arguments *arguments)
 
 /* ** Flush+Reload: */
 
-size_t flush_reload_threshold() {
+/**
+ * \brief Add a measure to a calibration histogram.
+ *
+ * \param hist The histogram, of CALIBRATION_BINS bins.
+ * \param time The measured time.
+ */
+static void calibration_hist_add(unsigned int * hist, int time) {
+    int bin = time / CALIBRATION_BIN_WIDTH;
+    hist[bin < 0 ? 0 : bin >= CALIBRATION_BINS ? CALIBRATION_BINS - 1 : bin]++;
+}
+
+/**
+ * \brief Detect the threshold to use for Flush+Reload attack on one address.
+ *
+ * \param ptr Address to reload and flush+reload.
+ * \param count Number of measures of each operation.
+ * \param cal If not NULL, structure where to store the means and the
+ *            histograms of the measures.
+ * \return size_t The computed threshold.
+ */
+static size_t flush_reload_threshold_ptr(void * ptr, size_t count, struct calibration * cal) {
     /* Number of cycle taken by reload and flush+reload operations. */
     size_t reload_time = 0, flush_reload_time = 0;
-    /* Number of operation to have a good estimation (arbitrary). If we are on
-       gem5, use a very low iteration count (or even 1) : gem5 is
-       deterministic. */
-    size_t count = gem5_is_sim() ? 10 : 100000;
-    /* Create dummy data to access. */
-    size_t dummy[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-    size_t *ptr = dummy + 8;
+    int time;
 
     /* Access to the data one time, and reload it. */
     mem_access(ptr);
-    for (int i = 0; i < count; i++)
-        reload_time += reload_t(ptr);
+    for (int i = 0; i < count; i++) {
+        reload_time += time = reload_t(ptr);
+        if (cal)
+            calibration_hist_add(cal->reload_hist, time);
+    }
     /* Flush the data and reload it. */
-    for (int i = 0; i < count; i++)
-        flush_reload_time += flush_reload_t(ptr);
+    for (int i = 0; i < count; i++) {
+        flush_reload_time += time = flush_reload_t(ptr);
+        if (cal)
+            calibration_hist_add(cal->flush_reload_hist, time);
+    }
     /* Compute the mean of the two measures above. */
     reload_time /= count;
     flush_reload_time /= count;
+    if (cal) {
+        cal->reload_mean = reload_time;
+        cal->flush_reload_mean = flush_reload_time;
+    }
     /* Compute an approximation of the middle of the two mean. */
     return (flush_reload_time + reload_time * 2) / 3;
 }
 
+size_t flush_reload_threshold() {
+    /* Number of operation to have a good estimation (arbitrary). If we are on
+       gem5, use a very low iteration count (or even 1) : gem5 is
+       deterministic. */
+    size_t count = gem5_is_sim() ? 10 : 100000;
+    /* Create dummy data to access. */
+    size_t dummy[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    size_t *ptr = dummy + 8;
+
+    return flush_reload_threshold_ptr(ptr, count, NULL);
+}
+
+void flush_reload_threshold_map(int * map, uint8_t * base, size_t stride) {
+    /* Lower than above since it is done 256 times. */
+    size_t count = gem5_is_sim() ? 10 : 1000;
+
+    for (int i = 0; i < 256; i++)
+        map[i] = flush_reload_threshold_ptr(base + i * stride, count, NULL);
+}
+
+void flush_reload_calibrate(struct calibration * cal, int per_line, uint8_t * base, size_t stride) {
+    /* Same as \sa {flush_reload_threshold()}. */
+    size_t count = gem5_is_sim() ? 10 : 100000;
+    size_t dummy[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    size_t *ptr = dummy + 8;
+
+    memset(cal, 0, sizeof(*cal));
+    cal->threshold = flush_reload_threshold_ptr(ptr, count, cal);
+    cal->margin = cal->flush_reload_mean - cal->reload_mean;
+    cal->per_line = per_line;
+    if (per_line)
+        flush_reload_threshold_map(cal->map, base, stride);
+    else
+        for (int i = 0; i < 256; i++)
+            cal->map[i] = cal->threshold;
+}
+
+int flush_reload_validate(struct calibration * cal) {
+    /* Only a small fraction of the complete calibration. */
+    size_t count = gem5_is_sim() ? 10 : 1000;
+    size_t dummy[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    size_t *ptr = dummy + 8;
+    struct calibration quick;
+
+    memset(&quick, 0, sizeof(quick));
+    flush_reload_threshold_ptr(ptr, count, &quick);
+    return quick.reload_mean <= cal->threshold && quick.flush_reload_mean > cal->threshold;
+}
+
+/* ** Calibration cache: */
+
+/**
+ * \brief Read the first integer of a file.
+ *
+ * \param path Path to the file.
+ * \return long The read integer, or -1 if the file can't be read.
+ */
+static long file_read_long(const char * path) {
+    FILE * f = fopen(path, "r");
+    long val = -1;
+    if (f) {
+        if (fscanf(f, "%li", &val) != 1)
+            val = -1;
+        fclose(f);
+    }
+    return val;
+}
+
+void calibration_fingerprint(char * buf, size_t size, size_t stride) {
+    char path[128];
+    int core = sched_getcpu();
+    long id = cpu_id(core), freq;
+
+    /* Maximum and not current frequency: the current one changes between
+       runs with DVFS, which would invalidate the cache each time. Neither is
+       the index of the core part of it: an unpinned program runs on any
+       core, and identical cores share the calibration. */
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", core);
+    freq = file_read_long(path);
+    snprintf(buf, size, "cpu=%#lx,freq=%ld,timer=%s,stride=%zu,gem5=%d",
+             id < 0 ? 0 : id, freq, TIMER_BACKEND, stride, !!gem5_is_sim());
+}
+
+/**
+ * \brief Write an array of integers on one line of a cache file.
+ *
+ * \param f The cache file.
+ * \param name Name of the array.
+ * \param array The array.
+ * \param size Number of elements in the array.
+ */
+static void calibration_write_array(FILE * f, const char * name, const unsigned int * array, size_t size) {
+    fprintf(f, "%s", name);
+    for (size_t i = 0; i < size; i++)
+        fprintf(f, " %u", array[i]);
+    fprintf(f, "\n");
+}
+
+/**
+ * \brief Read an array of integers written by \sa {calibration_write_array()}.
+ *
+ * \return int 0 on success, 1 if the array is malformed.
+ */
+static int calibration_read_array(FILE * f, const char * name, unsigned int * array, size_t size) {
+    char key[32];
+    if (fscanf(f, "%31s", key) != 1 || strcmp(key, name))
+        return 1;
+    for (size_t i = 0; i < size; i++)
+        if (fscanf(f, "%u", &array[i]) != 1)
+            return 1;
+    return 0;
+}
+
+int calibration_load(struct calibration * cal, const char * path, size_t stride) {
+    char current[FINGERPRINT_SIZE], stored[FINGERPRINT_SIZE];
+    FILE * f = fopen(path, "r");
+    int err = 1;
+
+    if (!f)
+        return 1;
+    calibration_fingerprint(current, sizeof(current), stride);
+    if (fscanf(f, "fingerprint %255s threshold %d reload_mean %d flush_reload_mean %d margin %d per_line %d",
+               stored, &cal->threshold, &cal->reload_mean, &cal->flush_reload_mean,
+               &cal->margin, &cal->per_line) == 6
+        && !strcmp(current, stored)
+        && !calibration_read_array(f, "reload_hist", cal->reload_hist, CALIBRATION_BINS)
+        && !calibration_read_array(f, "flush_reload_hist", cal->flush_reload_hist, CALIBRATION_BINS)
+        && !calibration_read_array(f, "map", (unsigned int *) cal->map, 256))
+        err = 0;
+    fclose(f);
+    return err;
+}
+
+int calibration_store(struct calibration * cal, const char * path, size_t stride) {
+    char current[FINGERPRINT_SIZE];
+    FILE * f = fopen(path, "w");
+
+    if (!f) {
+        fprintf(stderr, "Cannot write calibration cache \"%s\".\n", path);
+        return 1;
+    }
+    calibration_fingerprint(current, sizeof(current), stride);
+    fprintf(f, "fingerprint %s\nthreshold %d\nreload_mean %d\nflush_reload_mean %d\nmargin %d\nper_line %d\n",
+            current, cal->threshold, cal->reload_mean, cal->flush_reload_mean,
+            cal->margin, cal->per_line);
+    calibration_write_array(f, "reload_hist", cal->reload_hist, CALIBRATION_BINS);
+    calibration_write_array(f, "flush_reload_hist", cal->flush_reload_hist, CALIBRATION_BINS);
+    calibration_write_array(f, "map", (unsigned int *) cal->map, 256);
+    fclose(f);
+    return 0;
+}
+
 /* ** gem5: */
 
 int gem5_is_sim() {
     char *gem5_sim = getenv("GEM5_SIM");
     return gem5_sim ? strcmp(gem5_sim, "false") : 0;
 }
+
+void gem5_checkpoint() {
+    if (!gem5_is_sim()) {
+        fprintf(stderr, "Not under gem5 (GEM5_SIM), checkpoint skipped.\n");
+        return;
+    }
+    m5_checkpoint();
+}
@@ -10,6 +10,18 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
+#include <stdint.h>
+#include <stddef.h>
+
+/* * Constants: */
+
+/** Number of bins of the calibration histograms. The last bin holds all the
+    measures above the range. */
+#define CALIBRATION_BINS (64)
+
+/** Width of a calibration histogram bin, in timer units. */
+#define CALIBRATION_BIN_WIDTH (8)
+
 /* * Structures: */
 
 /**
@@ -30,13 +42,55 @@ struct arguments
     int tries;
     int loops;
     int cache_threshold;
+    char *charset;
+    int top_k;
+    int sample;
+    int sweep;
+    char *order;
+    int pool;
+    int per_line;
+    char *calibration_cache;
+    char *channel;
+    double sim_hit_rate;
+    double sim_fp_rate;
+    double sim_noise;
+    unsigned long sim_seed;
+    char *mitigation;
+    int victim_bench;
+    char *variant;
+    unsigned long op_distance;
+    char *confusion;
+    char *confusion_format;
+    int checkpoint;
+    int stl_delay;
 };
 
-/* * Variables: */
-
-/** Assume a cache hit if (time <= threshold). We can use a define for speed,
-    or a variable to compute it at runtime. */
-extern int CACHE_HIT_THRESHOLD;
+/**
+ * \brief Result of a Flush+Reload calibration.
+ *
+ * \details Computed by \sa {flush_reload_calibrate()}, it can be saved and
+ *          restored between runs with \sa {calibration_store()} and \sa
+ *          {calibration_load()}.
+ */
+struct calibration
+{
+    /** Global cache hit threshold. */
+    int threshold;
+    /** Mean time of a reload (cache hit). */
+    int reload_mean;
+    /** Mean time of a flush+reload (cache miss). */
+    int flush_reload_mean;
+    /** Distance between the two means above. */
+    int margin;
+    /** Histograms of the reload and flush+reload times. */
+    unsigned int reload_hist[CALIBRATION_BINS];
+    unsigned int flush_reload_hist[CALIBRATION_BINS];
+    /** 1 if "map" has been computed for each probe line, 0 if it is filled
+        with "threshold". */
+    int per_line;
+    /** Cache hit threshold of each probe line. */
+    int map[256];
+};
 
 /* * Prototypes: */
 
@@ -99,6 +153,80 @@ void arg_parse(int argc, char **argv, struct arguments *arguments);
  */
 size_t flush_reload_threshold();
 
+/**
+ * \brief Detect the threshold to use for each line of a probe array.
+ * \details Same as \sa {flush_reload_threshold()}, but the estimation is
+ *          done independently for each of the 256 probe lines, since they
+ *          are located in different cache sets, pages and DRAM banks.
+ *
+ * \param map Array of 256 int where to store the thresholds.
+ * \param base Address of the probe array.
+ * \param stride Distance in bytes between two probe lines.
+ */
+void flush_reload_threshold_map(int * map, uint8_t * base, size_t stride);
+
+/**
+ * \brief Perform a complete Flush+Reload calibration.
+ * \details Same as \sa {flush_reload_threshold()}, but also keep the means
+ *          and the histograms of the measures, and optionally compute the
+ *          threshold of each probe line.
+ *
+ * \param cal Structure where to store the calibration.
+ * \param per_line If 1, use \sa {flush_reload_threshold_map()} to fill the
+ *                 per-line thresholds. Otherwise, fill them with the global
+ *                 one.
+ * \param base Address of the probe array.
+ * \param stride Distance in bytes between two probe lines.
+ */
+void flush_reload_calibrate(struct calibration * cal, int per_line, uint8_t * base, size_t stride);
+
+/**
+ * \brief Quickly check that a calibration is still valid.
+ * \details Perform a small number of reload and flush+reload operations and
+ *          check that their means are still on each side of the threshold.
+ *
+ * \param cal The calibration to check.
+ * \return int 1 if the calibration is valid, 0 otherwise.
+ */
+int flush_reload_validate(struct calibration * cal);
+
+/**
+ * \brief Load a calibration from a cache file.
+ * \details The calibration is only loaded if the fingerprint stored in the
+ *          file matches the current one (\sa {calibration_fingerprint()}).
+ *
+ * \param cal Structure where to store the calibration.
+ * \param path Path to the cache file.
+ * \param stride Distance in bytes between two probe lines.
+ * \return int 0 on success, 1 if the file doesn't exist, is malformed or has
+ *             been created on another platform.
+ */
+int calibration_load(struct calibration * cal, const char * path, size_t stride);
+
+/**
+ * \brief Store a calibration into a cache file, with the current fingerprint.
+ *
+ * \param cal The calibration to store.
+ * \param path Path to the cache file.
+ * \param stride Distance in bytes between two probe lines.
+ * \return int 0 on success, 1 if the file can't be written.
+ */
+int calibration_store(struct calibration * cal, const char * path, size_t stride);
+
+/**
+ * \brief Compute the fingerprint of the current platform.
+ * \details The fingerprint identifies everything that influences the
+ *          calibration: the model (\sa {cpu_id()}) and the maximum frequency of
+ *          the type of core running the program, but not its index, the
+ *          timer backend, the probe stride and whether it runs under gem5.
+ *          It is a single line without spaces.
+ *
+ * \param buf Buffer where to store the fingerprint.
+ * \param size Size of the buffer.
+ * \param stride Distance in bytes between two probe lines.
+ */
+void calibration_fingerprint(char * buf, size_t size, size_t stride);
+
 /**
  * \brief Test if the program is under a gem5 simulation.
  * \details Use a user-defined environment variable (GEM5_SIM) to test for
@@ -109,4 +237,13 @@ size_t flush_reload_threshold();
  */
 int gem5_is_sim();
 
+/**
+ * \brief Take a gem5 checkpoint of the whole simulated system.
+ * \details Issue the m5 checkpoint pseudo-instruction (\sa {m5_checkpoint()}),
+ *          so that a simulation restored from it resumes right after this
+ *          call. Skipped with a warning if we are not under gem5 (\sa
+ *          {gem5_is_sim()}), where the instruction would be undefined.
+ */
+void gem5_checkpoint();
+
 #endif